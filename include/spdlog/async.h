@@ -9,18 +9,18 @@
 //
 // Async logging using global thread pool
 // All loggers created here share same global thread pool.
-// Each log message is pushed to a queue along withe a shared pointer to the
-// logger.
-// If a logger deleted while having pending messages in the queue, it's actual
-// destruction will defer
-// until all its messages are processed by the thread pool.
-// This is because each message in the queue holds a shared_ptr to the
-// originating logger.
+// Each log message is pushed to a queue along withe a raw pointer to the
+// logger (no reference counting on the hot path).
+// If a logger deleted while having pending messages in the queue, its
+// destructor blocks until the messages it posted so far are processed by the
+// thread pool.
+// Thus a logger must not be destroyed while its thread pool is being destroyed.
 
 #include "spdlog/async_logger.h"
 #include "spdlog/details/registry.h"
 #include "spdlog/details/thread_pool.h"
 
+#include <chrono>
 #include <memory>
 #include <mutex>
 
@@ -79,6 +79,39 @@ inline void init_thread_pool(size_t q_size, size_t thread_count)
     details::registry::instance().set_tp(std::move(tp));
 }
 
+// set global thread pool whose workers wait for messages with the given strategy.
+inline void init_thread_pool(
+    size_t q_size, size_t thread_count, async_wait_strategy wait_strategy, std::chrono::microseconds spin_budget = std::chrono::microseconds(50))
+{
+    auto tp = std::make_shared<details::thread_pool>(q_size, thread_count, wait_strategy, spin_budget);
+    details::registry::instance().set_tp(std::move(tp));
+}
+
+// set global thread pool with the given worker threads configuration.
+inline void init_thread_pool(size_t q_size, size_t thread_count, thread_pool_options options)
+{
+    auto tp = std::make_shared<details::thread_pool>(q_size, thread_count, std::move(options));
+    details::registry::instance().set_tp(std::move(tp));
+}
+
+#if defined(SPDLOG_ASYNC_SHM_JOURNAL)
+// write the log msgs a crashed process left unwritten in its shared memory journal
+// (thread_pool_options::shm_journal) to the given sink, oldest first, and delete the journal.
+// call it before creating the thread pool - which fails while a journal of that name exists.
+// return the number of recovered msgs (0 if there was no journal).
+inline size_t recover_async_journal(const std::string &journal_name, const sink_ptr &sink)
+{
+    size_t recovered = details::shm_journal::recover(journal_name, [&sink](const details::log_msg &msg) {
+        if (sink->should_log(msg.level))
+        {
+            sink->log(msg);
+        }
+    });
+    sink->flush();
+    return recovered;
+}
+#endif
+
 // get the global thread pool.
 inline std::shared_ptr<spdlog::details::thread_pool> thread_pool()
 {
@@ -17,34 +17,115 @@
 //    space is available in the queue)
 //    3. will throw spdlog_ex upon log exceptions
 // Upon destruction, logs all remaining messages in the queue before
-// destructing..
+// destructing.. (queued messages refer to the logger by raw pointer, so the
+// destructor waits until the thread pool has processed them)
+//
+// Single threaded (*_st) sinks can be used if one worker thread processes all
+// the logger's messages (a thread pool with one worker, or sharded): the sink
+// is then claimed for that worker, and rejected (spdlog_ex) by loggers fed by
+// another one. This saves a lock/unlock per message per sink.
 
 #include "spdlog/common.h"
 #include "spdlog/logger.h"
 
+#include <atomic>
 #include <chrono>
+#include <functional>
+#include <future>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace spdlog {
 
 // Async overflow policy - block by default.
 enum class async_overflow_policy
 {
-    block,         // Block until message can be enqueued
-    overrun_oldest // Discard oldest message in the queue if full when trying to
-                   // add new item.
+    block,          // Block until message can be enqueued
+    overrun_oldest, // Discard oldest message in the queue if full when trying to
+                    // add new item.
+    discard_new     // Discard the new message if the queue is full (counted by
+                    // async_logger::dropped_count()).
+};
+
+// How the thread pool's worker threads wait for new messages - blocking by default.
+enum class async_wait_strategy
+{
+    block,          // Sleep until a message is enqueued (producers pay for waking the worker up)
+    spin_then_park, // Poll the queue for up to the spin budget, then sleep
+    spin_yield,     // Poll the queue, yielding the cpu between polls
+    busy_spin       // Poll the queue non stop (burns a core, lowest latency)
+};
+
+// Worker threads configuration of a thread pool.
+// The affinity and scheduling settings are applied by each worker thread when it
+// starts, and the thread pool constructor throws if they fail.
+struct thread_pool_options
+{
+    async_wait_strategy wait_strategy = async_wait_strategy::block;
+    // how long a worker polls the queue before sleeping (async_wait_strategy::spin_then_park)
+    std::chrono::microseconds spin_budget{50};
+
+    // worker i is pinned to the cpus in cpu_affinity[i % cpu_affinity.size()] (not pinned if empty)
+    std::vector<std::vector<int>> cpu_affinity;
+    // worker i is named thread_name_prefix + i (best effort, not named if empty)
+    std::string thread_name_prefix = "spdlog-wrk-";
+    // SCHED_* policy and priority of the workers (not changed if sched_policy < 0, posix only)
+    int sched_policy = -1;
+    int sched_priority = 0;
+    // nice value of the workers (not changed if 0, linux only)
+    int nice = 0;
+
+    // give each worker its own queue, and each logger one of these queues (by hash of its name).
+    // the msgs of a logger are then processed in order even with several workers, and
+    // the sinks of loggers on different queues are written in parallel.
+    bool sharded = false;
+
+    // with several workers sharing the queue, let them format the batches in parallel but
+    // write them to the sinks one at a time, in the order they were dequeued: the msgs keep
+    // their order (as with one worker), while the formatting of the deferred log calls
+    // (SPDLOG_ASYNC_DEFERRED_FORMATTING) scales with the workers. The sinks still format
+    // and write each msg in turn. no effect if sharded or with one worker.
+    bool parallel_formatting = false;
+
+    // a queue a worker finds full is doubled, up to auto_grow_max_items (never grows if 0).
+    // bounds the memory of each queue to about auto_grow_max_items * sizeof(async_msg).
+    // not supported by SPDLOG_ASYNC_LOCKFREE_QUEUE / SPDLOG_ASYNC_SPSC_LANES.
+    size_t auto_grow_max_items = 0;
+
+    // on SIGSEGV, SIGABRT or SIGBUS, write the log msgs still queued to the file sinks of
+    // their loggers before the process dies (posix only, see details/crash_handler.h).
+    // requires SPDLOG_ASYNC_CRASH_DUMP (the thread pool throws otherwise).
+    bool crash_dump = false;
+
+    // name of a shared memory object (e.g. "/myapp-log") journaling the queued log msgs, so
+    // the ones a crashed process didn't write can be recovered (see recover_async_journal()).
+    // not journaled if empty. posix only, see details/shm_journal.h.
+    // requires SPDLOG_ASYNC_SHM_JOURNAL (the thread pool throws otherwise).
+    std::string shm_journal;
+    // number of records of the journal (default - room for every queued msg and worker batch)
+    size_t shm_journal_records = 0;
+
+    // called by each worker thread when it starts / before it exits
+    std::function<void()> on_thread_start;
+    std::function<void()> on_thread_stop;
 };
 
 namespace details {
 class thread_pool;
 }
 
+// An async logger keeps its thread pool alive: the queued msgs refer to the logger and
+// the logger to the pool by raw pointer, and the destructor waits for the logger's msgs.
+// So an async logger must not be destroyed by a worker thread of its own thread pool
+// (e.g. a sink or an error handler releasing its last reference) - the worker can't wait
+// for the msgs, and std::terminate() is called instead.
 class async_logger final : public std::enable_shared_from_this<async_logger>, public logger
 {
     friend class details::thread_pool;
 
 public:
+    // throws if the thread pool doesn't exist anymore
     template<typename It>
     async_logger(std::string logger_name, It begin, It end, std::weak_ptr<details::thread_pool> tp,
         async_overflow_policy overflow_policy = async_overflow_policy::block);
@@ -55,18 +136,54 @@ public:
     async_logger(std::string logger_name, sink_ptr single_sink, std::weak_ptr<details::thread_pool> tp,
         async_overflow_policy overflow_policy = async_overflow_policy::block);
 
+    ~async_logger() override;
+
     std::shared_ptr<logger> clone(std::string new_name) override;
 
+    // the formatters of the sinks that aren't thread safe are replaced by the worker
+    // thread feeding them, between two msgs (waits for it).
+    void set_formatter(std::unique_ptr<formatter> formatter) override;
+
+    // log without ever blocking or overrunning other messages, whatever the overflow policy.
+    // return false if the message was dropped because the queue is full.
+    template<typename... Args>
+    bool try_log(source_loc loc, level::level_enum lvl, const char *fmt, const Args &... args);
+
+    template<typename... Args>
+    bool try_log(level::level_enum lvl, const char *fmt, const Args &... args);
+
+    // flush the sinks once all the messages logged so far are written.
+    // the future is ready after the flush, or holds an spdlog_ex if the flush
+    // request was lost (e.g. overrun in the queue, or the thread pool was shut down).
+    std::future<void> flush_async();
+
+    // flush_async() and wait up to timeout for the flush to complete.
+    // return false on timeout or failure (reported to the error handler).
+    bool flush_and_wait(std::chrono::milliseconds timeout);
+
+    // number of messages dropped because the queue was full
+    // (by try_log() or the async_overflow_policy::discard_new policy).
+    size_t dropped_count() const;
+
 protected:
     void sink_it_(details::log_msg &msg) override;
     void flush_() override;
+#if defined(SPDLOG_ASYNC_DEFERRED_FORMATTING)
+    bool sink_deferred_(details::log_msg &msg, details::deferred_format_fn format_fn) override;
+#endif
 
     void backend_log_(const details::log_msg &incoming_log_msg);
+    void backend_sink_it_(const details::log_msg &incoming_log_msg);
+    bool backend_format_(details::deferred_format_fn format_fn, const char *packed, fmt::memory_buffer &dest);
     void backend_flush_();
 
+    bool post_log_(details::log_msg &msg, async_overflow_policy overflow_policy, details::deferred_format_fn format_fn);
+
 private:
-    std::weak_ptr<details::thread_pool> thread_pool_;
+    const std::shared_ptr<details::thread_pool> thread_pool_; // never null
     async_overflow_policy overflow_policy_;
+    size_t shard_key_; // selects the logger's queue in a sharded thread pool
+    std::atomic<size_t> dropped_count_{0};
 };
 } // namespace spdlog
 
@@ -10,17 +10,35 @@
 
 #include "spdlog/details/thread_pool.h"
 
+#include <algorithm>
 #include <chrono>
+#include <exception>
 #include <memory>
 #include <string>
 
 template<typename It>
 inline spdlog::async_logger::async_logger(
     std::string logger_name, It begin, It end, std::weak_ptr<details::thread_pool> tp, async_overflow_policy overflow_policy)
-    : logger(std::move(logger_name), begin, end)
-    , thread_pool_(std::move(tp))
+    : logger(std::move(logger_name), begin, end, no_sinks_claim())
+    , thread_pool_(tp.lock())
     , overflow_policy_(overflow_policy)
+    , shard_key_(std::hash<std::string>()(name_))
 {
+    if (!thread_pool_)
+    {
+        throw spdlog_ex("async logger: thread pool doesn't exist anymore");
+    }
+    // the sinks that aren't thread safe are accepted if a single worker thread processes all
+    // the msgs of this logger, and only loggers processed by that thread use them
+    sinks_consumer_ = thread_pool_->single_consumer_of(this);
+    auto error = claim_sinks_();
+    if (!error.empty())
+    {
+        throw spdlog_ex(error);
+    }
+#if defined(SPDLOG_ASYNC_DEFERRED_FORMATTING)
+    defers_formatting_ = true;
+#endif
 }
 
 inline spdlog::async_logger::async_logger(
@@ -35,39 +53,159 @@ inline spdlog::async_logger::async_logger(
 {
 }
 
+// drain-on-drop: wait until the messages still referring to this logger are processed
+inline spdlog::async_logger::~async_logger()
+{
+    if (thread_pool_->is_running_worker_thread())
+    {
+        // the worker can't wait for the msgs still referring to this logger (see async_logger.h)
+        try
+        {
+            err_handler_("async logger destroyed by a worker thread of its own thread pool");
+        }
+        catch (...)
+        {
+        }
+        std::terminate();
+    }
+    try
+    {
+        thread_pool_->drain_logger(this);
+    }
+    catch (...)
+    {
+    }
+}
+
+inline void spdlog::async_logger::set_formatter(std::unique_ptr<spdlog::formatter> f)
+{
+    bool single_threaded = std::any_of(sinks_.begin(), sinks_.end(), [](const sink_ptr &s) { return !s->thread_safe(); });
+    if (!single_threaded)
+    {
+        logger::set_formatter(std::move(f));
+        return;
+    }
+    std::shared_ptr<spdlog::formatter> shared_f(std::move(f));
+    thread_pool_->post_to_consumer(this, [this, shared_f] {
+        for (auto &sink : this->sinks_)
+        {
+            sink->set_formatter(shared_f->clone());
+        }
+    }).get();
+}
+
 // send the log message to the thread pool
 inline void spdlog::async_logger::sink_it_(details::log_msg &msg)
 {
-#if defined(SPDLOG_ENABLE_MESSAGE_COUNTER)
-    incr_msg_counter_(msg);
+    post_log_(msg, overflow_policy_, nullptr);
+}
+
+#if defined(SPDLOG_ASYNC_DEFERRED_FORMATTING)
+// send the packed log call to the thread pool, to be formatted by the worker thread
+inline bool spdlog::async_logger::sink_deferred_(details::log_msg &msg, details::deferred_format_fn format_fn)
+{
+    post_log_(msg, overflow_policy_, format_fn);
+    return true;
+}
 #endif
-    if (auto pool_ptr = thread_pool_.lock())
+
+template<typename... Args>
+inline bool spdlog::async_logger::try_log(source_loc source, level::level_enum lvl, const char *fmt, const Args &... args)
+{
+    if (!should_log(lvl))
     {
-        pool_ptr->post_log(shared_from_this(), msg, overflow_policy_);
+        return true;
     }
-    else
+
+    try
     {
-        throw spdlog_ex("async log: thread pool doesn't exist anymore");
+        using details::fmt_helper::to_string_view;
+        details::scoped_format_buffer scoped_buf;
+        fmt::memory_buffer &buf = scoped_buf.get();
+        fmt::format_to(buf, fmt, args...);
+        details::log_msg log_msg(source, &name_, lvl, to_string_view(buf));
+        return post_log_(log_msg, async_overflow_policy::discard_new, nullptr);
     }
+    SPDLOG_CATCH_AND_HANDLE
+    return false;
 }
 
-// send flush request to the thread pool
-inline void spdlog::async_logger::flush_()
+template<typename... Args>
+inline bool spdlog::async_logger::try_log(level::level_enum lvl, const char *fmt, const Args &... args)
 {
-    if (auto pool_ptr = thread_pool_.lock())
+    return try_log(source_loc{}, lvl, fmt, args...);
+}
+
+inline std::future<void> spdlog::async_logger::flush_async()
+{
+    try
+    {
+        return thread_pool_->post_flush_barrier(this);
+    }
+    catch (...)
+    {
+        std::promise<void> failed;
+        failed.set_exception(std::current_exception());
+        return failed.get_future();
+    }
+}
+
+inline bool spdlog::async_logger::flush_and_wait(std::chrono::milliseconds timeout)
+{
+    try
     {
-        pool_ptr->post_flush(shared_from_this(), overflow_policy_);
+        auto flushed = flush_async();
+        if (flushed.wait_for(timeout) != std::future_status::ready)
+        {
+            return false;
+        }
+        flushed.get();
+        return true;
     }
-    else
+    SPDLOG_CATCH_AND_HANDLE
+    return false;
+}
+
+inline size_t spdlog::async_logger::dropped_count() const
+{
+    return dropped_count_.load(std::memory_order_relaxed);
+}
+
+// send flush request to the thread pool
+inline void spdlog::async_logger::flush_()
+{
+    thread_pool_->post_flush(this, overflow_policy_);
+}
+
+// return false if the msg was dropped (async_overflow_policy::discard_new)
+inline bool spdlog::async_logger::post_log_(
+    details::log_msg &msg, async_overflow_policy overflow_policy, details::deferred_format_fn format_fn)
+{
+#if defined(SPDLOG_ENABLE_MESSAGE_COUNTER)
+    incr_msg_counter_(msg);
+#endif
+    if (thread_pool_->post_log(this, msg, overflow_policy, format_fn))
     {
-        throw spdlog_ex("async flush: thread pool doesn't exist anymore");
+        return true;
     }
+    dropped_count_.fetch_add(1, std::memory_order_relaxed);
+    return false;
 }
 
 //
 // backend functions - called from the thread pool to do the actual job
 //
 inline void spdlog::async_logger::backend_log_(const details::log_msg &incoming_log_msg)
+{
+    backend_sink_it_(incoming_log_msg);
+    if (should_flush_(incoming_log_msg))
+    {
+        backend_flush_();
+    }
+}
+
+// log to the sinks without applying the flush policy (the thread pool applies it once per batch)
+inline void spdlog::async_logger::backend_sink_it_(const details::log_msg &incoming_log_msg)
 {
     try
     {
@@ -80,11 +218,19 @@ inline void spdlog::async_logger::backend_log_(const details::log_msg &incoming_
         }
     }
     SPDLOG_CATCH_AND_HANDLE
+}
 
-    if (should_flush_(incoming_log_msg))
+// format a log call packed by the caller thread (SPDLOG_ASYNC_DEFERRED_FORMATTING)
+inline bool spdlog::async_logger::backend_format_(details::deferred_format_fn format_fn, const char *packed, fmt::memory_buffer &dest)
+{
+    try
     {
-        backend_flush_();
+        dest.clear();
+        format_fn(dest, packed);
+        return true;
     }
+    SPDLOG_CATCH_AND_HANDLE
+    return false;
 }
 
 inline void spdlog::async_logger::backend_flush_()
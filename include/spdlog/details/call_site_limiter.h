@@ -0,0 +1,339 @@
+//
+// Copyright(c) 2019 Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+#pragma once
+
+// rate limiting and sampling of one log call site (SPDLOG_LOGGER_EVERY_N and co. in spdlog.h).
+// Each macro expansion owns a static call_site_limiter and, per calling thread, a
+// thread local call_site_limiter::thread_slot. They are checked after the level and
+// before the arguments are evaluated or formatted. A suppressed call only loads the
+// call site's state (after a steady clock read for the time based checks) and bumps
+// the counters of its own thread's slot - there's no read-modify-write of shared state.
+// With SPDLOG_NO_TLS the threads share one slot per call site, bumped atomically.
+//
+// The number of msgs suppressed at the call site is logged, as a msg of its own,
+// right before the next msg it lets through - and for the loggers in the registry by
+// registry::flush_all() (spdlog::flush_every()) and spdlog::shutdown(), so the count
+// of a call site that went quiet isn't lost.
+
+#include "spdlog/common.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace spdlog {
+namespace details {
+
+class call_site_limiter
+{
+public:
+    // the calls of one thread at the call site
+    class thread_slot
+    {
+    public:
+        explicit thread_slot(call_site_limiter &limiter)
+            : limiter_(limiter)
+        {
+            limiter_.attach_(*this);
+        }
+
+        ~thread_slot()
+        {
+            limiter_.detach_(*this);
+        }
+
+        thread_slot(const thread_slot &) = delete;
+        thread_slot &operator=(const thread_slot &) = delete;
+
+    private:
+        friend class call_site_limiter;
+
+        call_site_limiter &limiter_;
+        std::atomic<uint64_t> calls_{0};
+        std::atomic<uint64_t> suppressed_{0};
+        uint64_t reported_ = 0; // under the limiter's mutex_
+        thread_slot *next_ = nullptr;
+    };
+
+    call_site_limiter(std::string logger_name, level::level_enum lvl, source_loc source)
+        : logger_name_(std::move(logger_name))
+        , level_(lvl)
+        , source_(source)
+    {
+        auto &sites = sites_();
+        std::lock_guard<std::mutex> lock(sites.mutex);
+        next_site_ = sites.head;
+        sites.head = this;
+    }
+
+    ~call_site_limiter()
+    {
+        auto &sites = sites_();
+        std::lock_guard<std::mutex> lock(sites.mutex);
+        for (auto **site = &sites.head; *site != nullptr; site = &(*site)->next_site_)
+        {
+            if (*site == this)
+            {
+                *site = next_site_;
+                break;
+            }
+        }
+    }
+
+    call_site_limiter(const call_site_limiter &) = delete;
+    call_site_limiter &operator=(const call_site_limiter &) = delete;
+
+    // let the first call of each thread through, then one of every n of its calls
+    bool every_n(thread_slot &slot, uint64_t n)
+    {
+        if (n <= 1 || bump_(slot.calls_) % n == 0)
+        {
+            return true;
+        }
+        return suppress_(slot);
+    }
+
+    // let a call through at most once per interval
+    bool every_interval(thread_slot &slot, std::chrono::nanoseconds interval)
+    {
+        const int64_t now = now_ns_();
+        int64_t next = next_ns_.load(std::memory_order_relaxed);
+        if (now < next || !next_ns_.compare_exchange_strong(next, now + interval.count(), std::memory_order_relaxed))
+        {
+            return suppress_(slot);
+        }
+        return true;
+    }
+
+    // token bucket of burst tokens, refilled at per_second tokens per second.
+    // implemented as a "generic cell rate algorithm": next_ns_ is the time the
+    // bucket will be full again.
+    bool token_bucket(thread_slot &slot, double per_second, double burst)
+    {
+        if (per_second <= 0)
+        {
+            return suppress_(slot);
+        }
+        const auto token_ns = static_cast<int64_t>(1e9 / per_second);
+        const auto burst_ns = static_cast<int64_t>((burst > 1 ? burst - 1 : 0) * 1e9 / per_second);
+        const int64_t now = now_ns_();
+        int64_t full_at = next_ns_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            if (full_at - burst_ns > now)
+            {
+                return suppress_(slot); // no token left
+            }
+            const int64_t new_full_at = (full_at > now ? full_at : now) + token_ns;
+            if (next_ns_.compare_exchange_weak(full_at, new_full_at, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+    }
+
+    // let each call through with the given probability (0-1)
+    bool sample(thread_slot &slot, double probability)
+    {
+        if (probability >= 1)
+        {
+            return true;
+        }
+        // the top 53 bits of a xorshift64* draw, as a double in [0, 1)
+        const double draw = static_cast<double>(next_random_() >> 11) * (1.0 / 9007199254740992.0);
+        if (draw < probability)
+        {
+            return true;
+        }
+        return suppress_(slot);
+    }
+
+    // log the msg, after the count of the msgs suppressed since the last report (if any)
+    template<typename Logger, typename... Args>
+    void log(Logger &logger, const Args &... args)
+    {
+        if (pending_.load(std::memory_order_relaxed))
+        {
+            const uint64_t suppressed = take_suppressed_();
+            if (suppressed != 0)
+            {
+                logger.log(source_, level_, "{} similar msgs suppressed", suppressed);
+            }
+        }
+        logger.log(source_, level_, args...);
+    }
+
+    // log the count of the msgs suppressed since the last report, for each call site of the logger
+    template<typename Logger>
+    static void log_suppressed(Logger &logger)
+    {
+        struct report
+        {
+            source_loc source;
+            level::level_enum lvl;
+            uint64_t suppressed;
+        };
+        std::vector<report> reports;
+        {
+            auto &sites = sites_();
+            std::lock_guard<std::mutex> lock(sites.mutex);
+            for (auto *site = sites.head; site != nullptr; site = site->next_site_)
+            {
+                if (site->logger_name_ == logger.name())
+                {
+                    const uint64_t suppressed = site->take_suppressed_();
+                    if (suppressed != 0)
+                    {
+                        reports.push_back(report{site->source_, site->level_, suppressed});
+                    }
+                }
+            }
+        }
+        // logged outside the lock: a sink may log through a call site of its own
+        for (const auto &r : reports)
+        {
+            logger.log(r.source, r.lvl, "{} similar msgs suppressed", r.suppressed);
+        }
+    }
+
+    // number of msgs suppressed since the last report
+    uint64_t suppressed()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t total = retired_;
+        for (auto *slot = slots_; slot != nullptr; slot = slot->next_)
+        {
+            total += slot->suppressed_.load(std::memory_order_relaxed) - slot->reported_;
+        }
+        return total;
+    }
+
+private:
+    struct site_list
+    {
+        std::mutex mutex;
+        call_site_limiter *head = nullptr;
+    };
+
+    // constructed by the first call site, so destroyed after the last one
+    static site_list &sites_()
+    {
+        static site_list sites;
+        return sites;
+    }
+
+    // bump a counter of a slot and return its previous value
+    static uint64_t bump_(std::atomic<uint64_t> &counter)
+    {
+#ifndef SPDLOG_NO_TLS
+        // only the slot's thread writes it - the atomic is for the readers in take_suppressed_()
+        const uint64_t value = counter.load(std::memory_order_relaxed);
+        counter.store(value + 1, std::memory_order_relaxed);
+        return value;
+#else
+        return counter.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+    bool suppress_(thread_slot &slot)
+    {
+        bump_(slot.suppressed_);
+        if (!pending_.load(std::memory_order_relaxed))
+        {
+            pending_.store(true, std::memory_order_relaxed);
+        }
+        return false;
+    }
+
+    uint64_t take_suppressed_()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.store(false, std::memory_order_relaxed);
+        uint64_t total = retired_;
+        retired_ = 0;
+        for (auto *slot = slots_; slot != nullptr; slot = slot->next_)
+        {
+            const uint64_t suppressed = slot->suppressed_.load(std::memory_order_relaxed);
+            total += suppressed - slot->reported_;
+            slot->reported_ = suppressed;
+        }
+        return total;
+    }
+
+    void attach_(thread_slot &slot)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slot.next_ = slots_;
+        slots_ = &slot;
+    }
+
+    // the unreported count of an exiting thread is kept for the next report
+    void detach_(thread_slot &slot)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        retired_ += slot.suppressed_.load(std::memory_order_relaxed) - slot.reported_;
+        for (auto **s = &slots_; *s != nullptr; s = &(*s)->next_)
+        {
+            if (*s == &slot)
+            {
+                *s = slot.next_;
+                break;
+            }
+        }
+    }
+
+    static int64_t now_ns_()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static uint64_t next_random_()
+    {
+#ifndef SPDLOG_NO_TLS
+        static thread_local uint64_t state = seed_();
+#else
+        static std::atomic<uint64_t> shared_state{seed_()};
+        uint64_t state = shared_state.load(std::memory_order_relaxed);
+#endif
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+#ifdef SPDLOG_NO_TLS
+        shared_state.store(state, std::memory_order_relaxed); // racy, good enough for sampling
+#endif
+        return state * 2685821657736338717ull;
+    }
+
+    static uint64_t seed_()
+    {
+        static std::atomic<uint64_t> seq{0};
+        uint64_t seed = static_cast<uint64_t>(now_ns_()) ^ (seq.fetch_add(1, std::memory_order_relaxed) * 0x9e3779b97f4a7c15ull);
+        return seed != 0 ? seed : 1;
+    }
+
+    const std::string logger_name_;
+    const level::level_enum level_;
+    const source_loc source_;
+    std::atomic<int64_t> next_ns_{0};
+    std::atomic<bool> pending_{false}; // some slot has unreported suppressed msgs
+
+    std::mutex mutex_; // guards the slots list, their reported_ and retired_
+    thread_slot *slots_ = nullptr;
+    uint64_t retired_ = 0;
+    call_site_limiter *next_site_ = nullptr; // under sites_().mutex
+};
+} // namespace details
+} // namespace spdlog
+
+#ifndef SPDLOG_NO_TLS
+#define SPDLOG_CALL_SITE_SLOT_STORAGE_ static thread_local
+#else
+#define SPDLOG_CALL_SITE_SLOT_STORAGE_ static
+#endif
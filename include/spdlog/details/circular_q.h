@@ -6,6 +6,7 @@
 // cirucal q view of std::vector.
 #pragma once
 
+#include <algorithm>
 #include <vector>
 
 namespace spdlog {
@@ -30,6 +31,7 @@ public:
 
         if (tail_ == head_) // overrun last item if full
         {
+            v_[head_] = T(); // release the overrun item now, not when its slot gets reused
             head_ = (head_ + 1) % max_items_;
             ++overrun_counter_;
         }
@@ -43,22 +45,66 @@ public:
         head_ = (head_ + 1) % max_items_;
     }
 
+    // If there are no elements in the container, the behavior is undefined.
+    const T &front() const
+    {
+        return v_[head_];
+    }
+
     bool empty()
     {
         return tail_ == head_;
     }
 
-    bool full()
+    bool full() const
     {
         // head is ahead of the tail by 1
         return ((tail_ + 1) % max_items_) == head_;
     }
 
+    size_t size() const
+    {
+        return (tail_ + max_items_ - head_) % max_items_;
+    }
+
+    size_t capacity() const
+    {
+        return max_items_ - 1;
+    }
+
+    // reallocate for max_items, keeping the items in order.
+    // never shrinks below the current number of items.
+    void resize(size_t max_items)
+    {
+        const size_t n = size();
+        const size_t new_max_items = (std::max)(max_items, n) + 1;
+        std::vector<T> v(new_max_items);
+        for (size_t i = 0; i < n; i++)
+        {
+            v[i] = std::move(v_[(head_ + i) % max_items_]);
+        }
+        v_.swap(v);
+        max_items_ = new_max_items;
+        head_ = 0;
+        tail_ = n;
+    }
+
     size_t overrun_counter() const
     {
         return overrun_counter_;
     }
 
+    // visit the items from the oldest as fn(header, payload), without moving them.
+    // for crash_handler only: the caller owns the queue or every other thread is stopped.
+    template<typename Fn>
+    void for_each_unsafe(Fn fn) const
+    {
+        for (size_t i = head_; i != tail_; i = (i + 1) % max_items_)
+        {
+            fn(v_[i], v_[i].payload());
+        }
+    }
+
 private:
     size_t max_items_;
     typename std::vector<T>::size_type head_ = 0;
@@ -0,0 +1,289 @@
+//
+// Copyright(c) 2019 Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+#pragma once
+
+// format strings parsed at compile time: SPDLOG_FMT("...").
+//   logger->info(SPDLOG_FMT("{} items in {}ms"), n, elapsed);
+// The format string is checked when the log call is compiled - malformed braces,
+// or a number of arguments different from the number of fields, fail to compile
+// instead of calling the error handler at run time.
+// A format string made of plain "{}" fields only (no format spec, index or
+// escaped brace) is also split at compile time: the log call appends the literal
+// segments and the arguments one after the other, without parsing anything.
+// Other format strings are formatted by fmt as usual.
+//
+// Requires c++14 (relaxed constexpr). With c++11, SPDLOG_FMT(s) is just s.
+// Not supported: named arguments and nested (dynamic width/precision) fields.
+
+#include "spdlog/common.h"
+#include "spdlog/details/deferred_args.h"
+#include "spdlog/details/fmt_helper.h"
+
+#include <string>
+#include <type_traits>
+
+#if defined(__cpp_constexpr) && __cpp_constexpr >= 201304
+#define SPDLOG_HAS_COMPILED_FORMAT 1
+#endif
+
+namespace spdlog {
+namespace details {
+
+// base of the format string types made by SPDLOG_FMT
+struct compiled_format_tag
+{
+};
+
+template<typename S>
+struct is_compiled_format : std::is_base_of<compiled_format_tag, S>
+{
+};
+
+#ifdef SPDLOG_HAS_COMPILED_FORMAT
+
+static const size_t invalid_format = static_cast<size_t>(-1);
+
+// only accepts string literals
+template<size_t N>
+constexpr size_t literal_size(const char (&)[N])
+{
+    return N - 1;
+}
+
+// number of arguments the format string s[0, n) takes, or invalid_format if malformed
+constexpr size_t format_arg_count(const char *s, size_t n)
+{
+    size_t auto_fields = 0;
+    size_t max_index = 0;
+    bool indexed = false;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (s[i] == '}')
+        {
+            if (i + 1 < n && s[i + 1] == '}')
+            {
+                i++;
+                continue;
+            }
+            return invalid_format;
+        }
+        if (s[i] != '{')
+        {
+            continue;
+        }
+        if (i + 1 < n && s[i + 1] == '{')
+        {
+            i++;
+            continue;
+        }
+        // {[index][:spec]}
+        size_t j = i + 1;
+        bool has_index = false;
+        size_t index = 0;
+        for (; j < n && s[j] >= '0' && s[j] <= '9'; j++)
+        {
+            index = index * 10 + static_cast<size_t>(s[j] - '0');
+            has_index = true;
+        }
+        if (j < n && s[j] != '}' && s[j] != ':')
+        {
+            return invalid_format;
+        }
+        for (; j < n && s[j] != '}'; j++)
+        {
+            if (s[j] == '{')
+            {
+                return invalid_format;
+            }
+        }
+        if (j == n)
+        {
+            return invalid_format;
+        }
+        if (has_index)
+        {
+            indexed = true;
+            max_index = index + 1 > max_index ? index + 1 : max_index;
+        }
+        else
+        {
+            auto_fields++;
+        }
+        i = j;
+    }
+    if (indexed && auto_fields > 0)
+    {
+        return invalid_format; // fmt can't mix automatic and manual indexing
+    }
+    return indexed ? max_index : auto_fields;
+}
+
+// true if every brace of s[0, n) belongs to a "{}" field
+constexpr bool is_plain_format(const char *s, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (s[i] == '}')
+        {
+            return false;
+        }
+        if (s[i] == '{')
+        {
+            if (i + 1 == n || s[i + 1] != '}')
+            {
+                return false;
+            }
+            i++;
+        }
+    }
+    return true;
+}
+
+// position of the k-th field of a plain format string (n if there is none)
+constexpr size_t plain_field_pos(const char *s, size_t n, size_t k)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (s[i] == '{')
+        {
+            if (k == 0)
+            {
+                return i;
+            }
+            k--;
+            i++;
+        }
+    }
+    return n;
+}
+
+// the k-th "{}" of S and the literal segment before it (k == number of fields: the tail)
+template<typename S, size_t K>
+struct plain_field
+{
+    using literal_begin = std::integral_constant<size_t, K == 0 ? 0 : plain_field_pos(S::data(), S::size(), K - 1) + 2>;
+    using pos = std::integral_constant<size_t, plain_field_pos(S::data(), S::size(), K)>;
+};
+
+template<typename T>
+inline void append_value_(const T &value, fmt::memory_buffer &dest)
+{
+    fmt::format_to(dest, "{}", value);
+}
+
+inline void append_value_(int value, fmt::memory_buffer &dest)
+{
+    fmt_helper::append_int(value, dest);
+}
+
+inline void append_value_(unsigned value, fmt::memory_buffer &dest)
+{
+    fmt_helper::append_int(value, dest);
+}
+
+inline void append_value_(long value, fmt::memory_buffer &dest)
+{
+    fmt_helper::append_int(value, dest);
+}
+
+inline void append_value_(unsigned long value, fmt::memory_buffer &dest)
+{
+    fmt_helper::append_int(value, dest);
+}
+
+inline void append_value_(long long value, fmt::memory_buffer &dest)
+{
+    fmt_helper::append_int(value, dest);
+}
+
+inline void append_value_(unsigned long long value, fmt::memory_buffer &dest)
+{
+    fmt_helper::append_int(value, dest);
+}
+
+inline void append_value_(const char *value, fmt::memory_buffer &dest)
+{
+    if (value == nullptr)
+    {
+        throw fmt::format_error("string pointer is null"); // as fmt does
+    }
+    fmt_helper::append_string_view(string_view_t(value), dest);
+}
+
+inline void append_value_(const std::string &value, fmt::memory_buffer &dest)
+{
+    fmt_helper::append_string_view(string_view_t(value.data(), value.size()), dest);
+}
+
+inline void append_value_(string_view_t value, fmt::memory_buffer &dest)
+{
+    fmt_helper::append_string_view(value, dest);
+}
+
+template<typename S, size_t K, typename T>
+inline void append_plain_field_(const T &value, fmt::memory_buffer &dest)
+{
+    using field = plain_field<S, K>;
+    dest.append(S::data() + field::literal_begin::value, S::data() + field::pos::value);
+    append_value_(value, dest);
+}
+
+template<typename S, typename... Args, size_t... Is>
+inline void format_plain_(fmt::memory_buffer &dest, index_sequence<Is...>, const Args &... args)
+{
+    using expander = int[];
+    (void)expander{0, (append_plain_field_<S, Is>(args, dest), 0)...};
+    using tail = plain_field<S, sizeof...(Args)>;
+    dest.append(S::data() + tail::literal_begin::value, S::data() + S::size());
+}
+
+template<typename S, typename... Args>
+inline void format_compiled_(std::true_type, fmt::memory_buffer &dest, const Args &... args)
+{
+    format_plain_<S>(dest, make_index_sequence<sizeof...(Args)>(), args...);
+}
+
+template<typename S, typename... Args>
+inline void format_compiled_(std::false_type, fmt::memory_buffer &dest, const Args &... args)
+{
+    fmt::format_to(dest, string_view_t(S::data(), S::size()), args...);
+}
+
+// format the args with the SPDLOG_FMT format string S (checked at compile time)
+template<typename S, typename... Args>
+inline void format_compiled(fmt::memory_buffer &dest, const Args &... args)
+{
+    static_assert(format_arg_count(S::data(), S::size()) != invalid_format,
+        "SPDLOG_FMT: invalid format string (or named args / nested fields, which are not supported)");
+    static_assert(format_arg_count(S::data(), S::size()) == sizeof...(Args),
+        "SPDLOG_FMT: the number of arguments doesn't match the format string");
+    using plain = std::integral_constant<bool, is_plain_format(S::data(), S::size())>;
+    format_compiled_<S>(plain(), dest, args...);
+}
+
+#endif // SPDLOG_HAS_COMPILED_FORMAT
+} // namespace details
+} // namespace spdlog
+
+#ifdef SPDLOG_HAS_COMPILED_FORMAT
+#define SPDLOG_FMT(s)                                                                                                                      \
+    [] {                                                                                                                                   \
+        struct spdlog_format_string : spdlog::details::compiled_format_tag                                                                 \
+        {                                                                                                                                  \
+            static constexpr const char *data()                                                                                            \
+            {                                                                                                                              \
+                return s;                                                                                                                  \
+            }                                                                                                                              \
+            static constexpr size_t size()                                                                                                 \
+            {                                                                                                                              \
+                return spdlog::details::literal_size(s);                                                                                   \
+            }                                                                                                                              \
+        };                                                                                                                                 \
+        return spdlog_format_string{};                                                                                                     \
+    }()
+#else
+#define SPDLOG_FMT(s) s
+#endif
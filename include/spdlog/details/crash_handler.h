@@ -0,0 +1,307 @@
+#pragma once
+
+//
+// Copyright(c) 2019 Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+// last resort dump of the async queues on fatal signals (thread_pool_options::crash_dump).
+// On SIGSEGV, SIGABRT or SIGBUS, the handler lets each registered thread pool
+// write its queued log msgs straight to the file descriptors of the file sinks,
+// ends each written file with a marker line, and re-raises the signal with the
+// previous handlers restored (so core dumps and other crash reporters still work).
+//
+// Only async-signal-safe calls are made from the handler: no locks, no
+// allocations and no formatter - the msgs are written with write(2) as
+// "[epoch micros] [logger] [level] payload" lines.
+// The dump is best effort: msgs being pushed or popped at the time of the
+// crash may be missing or torn, the msg a worker was writing may appear twice,
+// and the msgs already written but still in a sink's stdio buffer are lost.
+//
+// Posix only: crash_handler::add() returns false on windows.
+
+#include "spdlog/common.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+#ifndef _WIN32
+#include <csignal>
+#include <unistd.h>
+#endif
+
+#ifndef SPDLOG_CRASH_HANDLER_MAX_POOLS
+#define SPDLOG_CRASH_HANDLER_MAX_POOLS 16
+#endif
+
+namespace spdlog {
+namespace details {
+
+// writes the msgs dumped on a signal, counting them per file descriptor.
+// lives on the stack of the signal handler.
+class crash_writer
+{
+public:
+    static const size_t max_fds = 64;
+
+    explicit crash_writer(int sig)
+        : sig_(sig)
+    {
+    }
+
+    crash_writer(const crash_writer &) = delete;
+    crash_writer &operator=(const crash_writer &) = delete;
+
+    // write "[micros] [logger_name] [level_name] payload\n" to fd
+    void write_msg(int fd, int64_t micros, string_view_t logger_name, string_view_t level_name, string_view_t payload)
+    {
+        size_t *count = count_of_(fd);
+        if (count == nullptr)
+        {
+            return; // too many files
+        }
+        append_(fd, "[", 1);
+        append_int_(fd, micros);
+        append_(fd, "] [", 3);
+        append_(fd, logger_name.data(), logger_name.size());
+        append_(fd, "] [", 3);
+        append_(fd, level_name.data(), level_name.size());
+        append_(fd, "] ", 2);
+        append_(fd, payload.data(), payload.size());
+        append_(fd, "\n", 1);
+        flush_(fd);
+        ++*count;
+    }
+
+    // write the marker line to every file written so far
+    void finish()
+    {
+        for (size_t i = 0; i < fds_n_; i++)
+        {
+            static const char prefix[] = "*** spdlog: wrote ";
+            static const char middle[] = " queued msgs on signal ";
+            append_(fds_[i], prefix, sizeof(prefix) - 1);
+            append_int_(fds_[i], static_cast<int64_t>(counts_[i]));
+            append_(fds_[i], middle, sizeof(middle) - 1);
+            append_int_(fds_[i], sig_);
+            append_(fds_[i], " ***\n", 5);
+            flush_(fds_[i]);
+        }
+    }
+
+private:
+    size_t *count_of_(int fd)
+    {
+        for (size_t i = 0; i < fds_n_; i++)
+        {
+            if (fds_[i] == fd)
+            {
+                return &counts_[i];
+            }
+        }
+        if (fds_n_ == max_fds)
+        {
+            return nullptr;
+        }
+        fds_[fds_n_] = fd;
+        counts_[fds_n_] = 0;
+        return &counts_[fds_n_++];
+    }
+
+    void append_int_(int fd, int64_t n)
+    {
+        char digits[24];
+        size_t len = 0;
+        uint64_t u = n < 0 ? 0 - static_cast<uint64_t>(n) : static_cast<uint64_t>(n);
+        do
+        {
+            digits[sizeof(digits) - ++len] = static_cast<char>('0' + u % 10);
+            u /= 10;
+        } while (u != 0);
+        if (n < 0)
+        {
+            digits[sizeof(digits) - ++len] = '-';
+        }
+        append_(fd, digits + sizeof(digits) - len, len);
+    }
+
+    // buffer small pieces, write big ones (e.g. long payloads) right through
+    void append_(int fd, const char *data, size_t size)
+    {
+        if (buf_n_ + size > sizeof(buf_))
+        {
+            flush_(fd);
+            if (size > sizeof(buf_))
+            {
+                write_all_(fd, data, size);
+                return;
+            }
+        }
+        std::memcpy(buf_ + buf_n_, data, size);
+        buf_n_ += size;
+    }
+
+    void flush_(int fd)
+    {
+        write_all_(fd, buf_, buf_n_);
+        buf_n_ = 0;
+    }
+
+    static void write_all_(int fd, const char *data, size_t size)
+    {
+#ifndef _WIN32
+        while (size > 0)
+        {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (written <= 0)
+            {
+                return;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+#else
+        (void)fd;
+        (void)data;
+        (void)size;
+#endif
+    }
+
+    int sig_;
+    char buf_[512];
+    size_t buf_n_ = 0;
+    int fds_[max_fds];
+    size_t counts_[max_fds];
+    size_t fds_n_ = 0;
+};
+
+// dumps the queued msgs of ctx (e.g. a thread pool) with the given writer
+using crash_dump_fn = void (*)(void *ctx, crash_writer &writer);
+
+// registry of what to dump on fatal signals.
+// add() and remove() may be called from any thread, but not concurrently with a crash.
+class crash_handler
+{
+public:
+    // register ctx to be dumped on fatal signals. the signal handlers are installed on first use.
+    // return false if not supported, or if SPDLOG_CRASH_HANDLER_MAX_POOLS are already registered.
+    static bool add(void *ctx, crash_dump_fn fn)
+    {
+#ifndef _WIN32
+        install_();
+        for (auto &s : slots_())
+        {
+            void *expected = nullptr;
+            if (s.ctx.compare_exchange_strong(expected, ctx))
+            {
+                s.fn.store(fn);
+                return true;
+            }
+        }
+#else
+        (void)ctx;
+        (void)fn;
+#endif
+        return false;
+    }
+
+    static void remove(void *ctx)
+    {
+        for (auto &s : slots_())
+        {
+            if (s.ctx.load() == ctx)
+            {
+                s.fn.store(nullptr);
+                s.ctx.store(nullptr);
+            }
+        }
+    }
+
+private:
+    struct slot
+    {
+        std::atomic<void *> ctx{nullptr};
+        std::atomic<crash_dump_fn> fn{nullptr};
+    };
+
+    using slots_t = slot[SPDLOG_CRASH_HANDLER_MAX_POOLS];
+
+    static slots_t &slots_()
+    {
+        static slots_t slots;
+        return slots;
+    }
+
+#ifndef _WIN32
+    static const size_t signals_n = 3;
+
+    static const int *signals_()
+    {
+        static const int signals[signals_n] = {SIGSEGV, SIGABRT, SIGBUS};
+        return signals;
+    }
+
+    static struct sigaction *previous_actions_()
+    {
+        static struct sigaction previous[signals_n];
+        return previous;
+    }
+
+    static void install_()
+    {
+        static std::mutex install_mutex;
+        static bool installed = false;
+        std::lock_guard<std::mutex> lock(install_mutex);
+        if (installed)
+        {
+            return;
+        }
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_handler = on_signal_;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_ONSTACK; // use the thread's alternate stack if any (e.g. on stack overflow)
+        for (size_t i = 0; i < signals_n; i++)
+        {
+            sigaction(signals_()[i], &action, &previous_actions_()[i]);
+        }
+        installed = true;
+    }
+
+    static void on_signal_(int sig)
+    {
+        static std::atomic<bool> dumped{false};
+        // restore the previous handlers first, so the re-raised signal (or a fault
+        // while dumping) goes to them
+        for (size_t i = 0; i < signals_n; i++)
+        {
+            sigaction(signals_()[i], &previous_actions_()[i], nullptr);
+        }
+        if (!dumped.exchange(true))
+        {
+            crash_writer writer(sig);
+            for (auto &s : slots_())
+            {
+                void *ctx = s.ctx.load();
+                crash_dump_fn fn = s.fn.load();
+                if (ctx != nullptr && fn != nullptr)
+                {
+                    fn(ctx, writer);
+                }
+            }
+            writer.finish();
+        }
+        // delivered once this handler returns (the signal is blocked meanwhile)
+        raise(sig);
+    }
+#endif
+};
+} // namespace details
+} // namespace spdlog
@@ -0,0 +1,139 @@
+//
+// Copyright(c) 2019 Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+#pragma once
+
+// support for deferred formatting (SPDLOG_ASYNC_DEFERRED_FORMATTING):
+// the format string address and the arguments of a log call are packed as raw
+// bytes on the caller thread, and formatted later by the async worker thread
+// (see async_logger::sink_deferred_).
+// Only static format strings (SPDLOG_FMT) and self contained values can be
+// packed - anything that may point to the caller's memory (runtime format
+// strings, strings, string views, pointers..) is formatted eagerly.
+
+#include "spdlog/common.h"
+
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+
+namespace spdlog {
+
+// arguments of type T can be copied as raw bytes and formatted on another thread.
+// specialize for trivially copyable user types that don't refer to other memory.
+template<typename T>
+struct is_deferrable_arg : std::integral_constant<bool, std::is_arithmetic<T>::value || std::is_enum<T>::value>
+{
+};
+
+namespace details {
+
+template<typename... Args>
+struct all_deferrable_args : std::true_type
+{
+};
+
+template<typename T, typename... Rest>
+struct all_deferrable_args<T, Rest...>
+    : std::integral_constant<bool, is_deferrable_arg<T>::value && all_deferrable_args<Rest...>::value>
+{
+};
+
+// formats a packed log call (format string address followed by the args) into dest
+using deferred_format_fn = void (*)(fmt::memory_buffer &dest, const char *packed);
+
+// (std::index_sequence is c++14)
+template<size_t... Is>
+struct index_sequence
+{
+};
+
+template<size_t N, size_t... Is>
+struct make_index_sequence : make_index_sequence<N - 1, N - 1, Is...>
+{
+};
+
+template<size_t... Is>
+struct make_index_sequence<0, Is...> : index_sequence<Is...>
+{
+};
+
+template<typename... Args>
+struct deferred_args
+{
+    static const size_t packed_size = 0;
+
+    static void pack(char *)
+    {
+    }
+};
+
+template<typename T, typename... Rest>
+struct deferred_args<T, Rest...>
+{
+    static_assert(std::is_trivially_copyable<T>::value, "spdlog::is_deferrable_arg<T> requires a trivially copyable T");
+
+    static const size_t packed_size = sizeof(T) + deferred_args<Rest...>::packed_size;
+
+    static void pack(char *dest, const T &first, const Rest &... rest)
+    {
+        std::memcpy(dest, &first, sizeof(T));
+        deferred_args<Rest...>::pack(dest + sizeof(T), rest...);
+    }
+};
+
+// offset of the I-th packed arg
+template<size_t I, typename... Args>
+struct deferred_arg_offset;
+
+template<typename T, typename... Rest>
+struct deferred_arg_offset<0, T, Rest...> : std::integral_constant<size_t, 0>
+{
+};
+
+template<size_t I, typename T, typename... Rest>
+struct deferred_arg_offset<I, T, Rest...> : std::integral_constant<size_t, sizeof(T) + deferred_arg_offset<I - 1, Rest...>::value>
+{
+};
+
+// the packed bytes are not aligned - copy the value out (T needn't be default constructible)
+template<typename T>
+inline T unpack_deferred_arg(const char *src)
+{
+    typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage;
+    std::memcpy(&storage, src, sizeof(T));
+    return *reinterpret_cast<const T *>(&storage);
+}
+
+// packs a log call with the given argument types, and formats it back (deferred_format_fn)
+template<typename... Args>
+struct deferred_formatter
+{
+    static const size_t packed_size = sizeof(const char *) + deferred_args<Args...>::packed_size;
+
+    static void pack(char *dest, const char *fmt, const Args &... args)
+    {
+        std::memcpy(dest, &fmt, sizeof(fmt));
+        deferred_args<Args...>::pack(dest + sizeof(fmt), args...);
+    }
+
+    static void format(fmt::memory_buffer &dest, const char *packed)
+    {
+        const char *fmt;
+        std::memcpy(&fmt, packed, sizeof(fmt));
+        format_(dest, fmt, packed + sizeof(fmt), make_index_sequence<sizeof...(Args)>());
+    }
+
+private:
+    template<size_t... Is>
+    static void format_(fmt::memory_buffer &dest, const char *fmt, const char *packed_args, index_sequence<Is...>)
+    {
+        fmt::format_to(dest, fmt,
+            unpack_deferred_arg<typename std::tuple_element<Is, std::tuple<Args...>>::type>(
+                packed_args + deferred_arg_offset<Is, Args...>::value)...);
+    }
+};
+} // namespace details
+} // namespace spdlog
@@ -12,6 +12,7 @@
 #include "spdlog/details/log_msg.h"
 #include "spdlog/details/os.h"
 
+#include <atomic>
 #include <cerrno>
 #include <chrono>
 #include <cstdio>
@@ -48,6 +49,7 @@ public:
         {
             if (!os::fopen_s(&fd_, fname, mode))
             {
+                native_fd_.store(os::file_descriptor(fd_), std::memory_order_relaxed);
                 return;
             }
 
@@ -75,6 +77,7 @@ public:
     {
         if (fd_ != nullptr)
         {
+            native_fd_.store(-1, std::memory_order_relaxed);
             std::fclose(fd_);
             fd_ = nullptr;
         }
@@ -104,6 +107,13 @@ public:
         return _filename;
     }
 
+    // file descriptor of the open file (-1 if closed).
+    // lock free, so it can be read from a signal handler while the file is written.
+    int native_fd() const
+    {
+        return native_fd_.load(std::memory_order_relaxed);
+    }
+
     static bool file_exists(const filename_t &fname)
     {
         return os::file_exists(fname);
@@ -146,6 +156,7 @@ public:
 
 private:
     std::FILE *fd_{nullptr};
+    std::atomic<int> native_fd_{-1};
     filename_t _filename;
 };
 } // namespace details
@@ -0,0 +1,120 @@
+//
+// Copyright(c) 2019 Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+#pragma once
+
+// reusable format buffers of the calling thread, for the log calls and the sinks.
+// A scoped_format_buffer borrows the next free buffer of the thread's arena and
+// gives it back when it goes out of scope - nested log calls (e.g. a sink or a
+// formatted argument that logs) borrow the next one.
+// The buffers keep their capacity between log calls, so the long msgs stop
+// allocating once the buffers grew to their size. A buffer that grew beyond
+// SPDLOG_FORMAT_BUFFER_MAX_RETAINED bytes is released after use, so a rare huge
+// msg doesn't pin its memory for the life of the thread.
+//
+// With SPDLOG_NO_TLS each scoped_format_buffer is a local fmt::memory_buffer.
+
+#include "spdlog/common.h"
+
+#include <memory>
+#include <vector>
+
+#ifndef SPDLOG_FORMAT_BUFFER_MAX_RETAINED
+#define SPDLOG_FORMAT_BUFFER_MAX_RETAINED (64 * 1024)
+#endif
+
+namespace spdlog {
+namespace details {
+
+class scoped_format_buffer
+{
+public:
+#ifndef SPDLOG_NO_TLS
+    scoped_format_buffer()
+    {
+        arena *a = arena::of_this_thread();
+        if (a == nullptr)
+        {
+            // the arena was destroyed (log call from another thread local's destructor)
+            own_ = details::make_unique<fmt::memory_buffer>();
+            buf_ = own_.get();
+            return;
+        }
+        if (a->used == a->buffers.size())
+        {
+            a->buffers.push_back(details::make_unique<fmt::memory_buffer>());
+        }
+        buf_ = a->buffers[a->used++].get();
+        buf_->clear();
+    }
+
+    ~scoped_format_buffer()
+    {
+        if (own_)
+        {
+            return;
+        }
+        if (buf_->capacity() > SPDLOG_FORMAT_BUFFER_MAX_RETAINED)
+        {
+            *buf_ = fmt::memory_buffer(); // back to the inline storage
+        }
+        --arena::of_this_thread()->used;
+    }
+#else
+    scoped_format_buffer()
+        : buf_(&local_)
+    {
+    }
+#endif
+
+    scoped_format_buffer(const scoped_format_buffer &) = delete;
+    scoped_format_buffer &operator=(const scoped_format_buffer &) = delete;
+
+    fmt::memory_buffer &get()
+    {
+        return *buf_;
+    }
+
+private:
+#ifndef SPDLOG_NO_TLS
+    // the buffers of a thread, borrowed in stack order
+    struct arena
+    {
+        std::vector<std::unique_ptr<fmt::memory_buffer>> buffers;
+        size_t used = 0;
+
+        arena()
+        {
+            alive_() = true;
+        }
+
+        ~arena()
+        {
+            alive_() = false;
+        }
+
+        // nullptr once the thread's arena was destroyed
+        static arena *of_this_thread()
+        {
+            static thread_local arena instance;
+            return alive_() ? &instance : nullptr;
+        }
+
+        // trivially destructible, so still readable after the arena's destruction
+        static bool &alive_()
+        {
+            static thread_local bool alive = false;
+            return alive;
+        }
+    };
+
+    std::unique_ptr<fmt::memory_buffer> own_;
+#else
+    fmt::memory_buffer local_;
+#endif
+    fmt::memory_buffer *buf_ = nullptr;
+};
+} // namespace details
+} // namespace spdlog
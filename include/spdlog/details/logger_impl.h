@@ -6,7 +6,9 @@
 #pragma once
 
 #include "spdlog/details/fmt_helper.h"
+#include "spdlog/details/format_buffer.h"
 
+#include <algorithm>
 #include <memory>
 #include <string>
 
@@ -24,6 +26,18 @@
 // all other ctors will call this one
 template<typename It>
 inline spdlog::logger::logger(std::string logger_name, It begin, It end)
+    : logger(std::move(logger_name), begin, end, no_sinks_claim())
+{
+    sinks_consumer_ = sinks::sink::sync_consumer();
+    auto error = claim_sinks_();
+    if (!error.empty())
+    {
+        throw spdlog_ex(error);
+    }
+}
+
+template<typename It>
+inline spdlog::logger::logger(std::string logger_name, It begin, It end, no_sinks_claim)
     : name_(std::move(logger_name))
     , sinks_(begin, end)
 {
@@ -41,7 +55,10 @@ inline spdlog::logger::logger(std::string logger_name, spdlog::sink_ptr single_s
 {
 }
 
-inline spdlog::logger::~logger() = default;
+inline spdlog::logger::~logger()
+{
+    release_sinks_();
+}
 
 inline void spdlog::logger::set_formatter(std::unique_ptr<spdlog::formatter> f)
 {
@@ -68,7 +85,8 @@ inline void spdlog::logger::log(source_loc source, level::level_enum lvl, const
     try
     {
         using details::fmt_helper::to_string_view;
-        fmt::memory_buffer buf;
+        details::scoped_format_buffer scoped_buf;
+        fmt::memory_buffer &buf = scoped_buf.get();
         fmt::format_to(buf, fmt, args...);
         details::log_msg log_msg(source, &name_, lvl, to_string_view(buf));
         sink_it_(log_msg);
@@ -123,7 +141,8 @@ inline void spdlog::logger::log(level::level_enum lvl, const T &msg)
     log(source_loc{}, lvl, msg);
 }
 
-template<class T, typename std::enable_if<!std::is_convertible<T, spdlog::string_view_t>::value, T>::type *>
+template<class T,
+    typename std::enable_if<!std::is_convertible<T, spdlog::string_view_t>::value && !spdlog::details::is_compiled_format<T>::value, T>::type *>
 inline void spdlog::logger::log(source_loc source, level::level_enum lvl, const T &msg)
 {
     if (!should_log(lvl))
@@ -133,7 +152,8 @@ inline void spdlog::logger::log(source_loc source, level::level_enum lvl, const
     try
     {
         using details::fmt_helper::to_string_view;
-        fmt::memory_buffer buf;
+        details::scoped_format_buffer scoped_buf;
+        fmt::memory_buffer &buf = scoped_buf.get();
         fmt::format_to(buf, "{}", msg);
         details::log_msg log_msg(source, &name_, lvl, to_string_view(buf));
         sink_it_(log_msg);
@@ -141,7 +161,8 @@ inline void spdlog::logger::log(source_loc source, level::level_enum lvl, const
     SPDLOG_CATCH_AND_HANDLE
 }
 
-template<class T, typename std::enable_if<!std::is_convertible<T, spdlog::string_view_t>::value, T>::type *>
+template<class T,
+    typename std::enable_if<!std::is_convertible<T, spdlog::string_view_t>::value && !spdlog::details::is_compiled_format<T>::value, T>::type *>
 inline void spdlog::logger::log(level::level_enum lvl, const T &msg)
 {
     log(source_loc{}, lvl, msg);
@@ -183,6 +204,79 @@ inline void spdlog::logger::critical(const char *fmt, const Args &... args)
     log(level::critical, fmt, args...);
 }
 
+#ifdef SPDLOG_HAS_COMPILED_FORMAT
+template<typename S, typename... Args, typename std::enable_if<spdlog::details::is_compiled_format<S>::value, int>::type>
+inline void spdlog::logger::log(source_loc source, level::level_enum lvl, const S &fmt, const Args &... args)
+{
+    (void)fmt;
+    if (!should_log(lvl))
+    {
+        return;
+    }
+
+    try
+    {
+#if defined(SPDLOG_ASYNC_DEFERRED_FORMATTING)
+        // the format string of SPDLOG_FMT is static - it outlives the queued msg
+        using deferrable = std::integral_constant<bool, sizeof...(Args) != 0 && details::all_deferrable_args<Args...>::value>;
+        if (defers_formatting_ && log_deferred_(deferrable(), source, lvl, S::data(), args...))
+        {
+            return;
+        }
+#endif
+        using details::fmt_helper::to_string_view;
+        details::scoped_format_buffer scoped_buf;
+        fmt::memory_buffer &buf = scoped_buf.get();
+        details::format_compiled<S>(buf, args...);
+        details::log_msg log_msg(source, &name_, lvl, to_string_view(buf));
+        sink_it_(log_msg);
+    }
+    SPDLOG_CATCH_AND_HANDLE
+}
+
+template<typename S, typename... Args, typename std::enable_if<spdlog::details::is_compiled_format<S>::value, int>::type>
+inline void spdlog::logger::log(level::level_enum lvl, const S &fmt, const Args &... args)
+{
+    log(source_loc{}, lvl, fmt, args...);
+}
+
+template<typename S, typename... Args, typename std::enable_if<spdlog::details::is_compiled_format<S>::value, int>::type>
+inline void spdlog::logger::trace(const S &fmt, const Args &... args)
+{
+    log(level::trace, fmt, args...);
+}
+
+template<typename S, typename... Args, typename std::enable_if<spdlog::details::is_compiled_format<S>::value, int>::type>
+inline void spdlog::logger::debug(const S &fmt, const Args &... args)
+{
+    log(level::debug, fmt, args...);
+}
+
+template<typename S, typename... Args, typename std::enable_if<spdlog::details::is_compiled_format<S>::value, int>::type>
+inline void spdlog::logger::info(const S &fmt, const Args &... args)
+{
+    log(level::info, fmt, args...);
+}
+
+template<typename S, typename... Args, typename std::enable_if<spdlog::details::is_compiled_format<S>::value, int>::type>
+inline void spdlog::logger::warn(const S &fmt, const Args &... args)
+{
+    log(level::warn, fmt, args...);
+}
+
+template<typename S, typename... Args, typename std::enable_if<spdlog::details::is_compiled_format<S>::value, int>::type>
+inline void spdlog::logger::error(const S &fmt, const Args &... args)
+{
+    log(level::err, fmt, args...);
+}
+
+template<typename S, typename... Args, typename std::enable_if<spdlog::details::is_compiled_format<S>::value, int>::type>
+inline void spdlog::logger::critical(const S &fmt, const Args &... args)
+{
+    log(level::critical, fmt, args...);
+}
+#endif // SPDLOG_HAS_COMPILED_FORMAT
+
 template<typename T>
 inline void spdlog::logger::trace(const T &msg)
 {
@@ -219,6 +313,26 @@ inline void spdlog::logger::critical(const T &msg)
     log(level::critical, msg);
 }
 
+template<typename F>
+inline void spdlog::logger::log_lazy(source_loc source, level::level_enum lvl, const F &fn)
+{
+    if (!should_log(lvl))
+    {
+        return;
+    }
+    try
+    {
+        log(source, lvl, fn());
+    }
+    SPDLOG_CATCH_AND_HANDLE
+}
+
+template<typename F>
+inline void spdlog::logger::log_lazy(level::level_enum lvl, const F &fn)
+{
+    log_lazy(source_loc{}, lvl, fn);
+}
+
 #ifdef SPDLOG_WCHAR_TO_UTF8_SUPPORT
 
 inline void wbuf_to_utf8buf(const fmt::wmemory_buffer &wbuf, fmt::memory_buffer &target)
@@ -256,7 +370,8 @@ inline void spdlog::logger::log(source_loc source, level::level_enum lvl, const
         using details::fmt_helper::to_string_view;
         fmt::wmemory_buffer wbuf;
         fmt::format_to(wbuf, fmt, args...);
-        fmt::memory_buffer buf;
+        details::scoped_format_buffer scoped_buf;
+        fmt::memory_buffer &buf = scoped_buf.get();
         wbuf_to_utf8buf(wbuf, buf);
         details::log_msg log_msg(source, &name_, lvl, to_string_view(buf));
         sink_it_(log_msg);
@@ -371,6 +486,32 @@ inline bool spdlog::logger::should_log(spdlog::level::level_enum msg_level) cons
     return msg_level >= level_.load(std::memory_order_relaxed);
 }
 
+#if defined(SPDLOG_ASYNC_DEFERRED_FORMATTING)
+inline bool spdlog::logger::sink_deferred_(details::log_msg &, details::deferred_format_fn)
+{
+    return false;
+}
+
+// pack the (static) format string address and the args instead of formatting them
+template<typename... Args>
+inline bool spdlog::logger::log_deferred_(std::true_type, source_loc source, level::level_enum lvl, const char *fmt, const Args &... args)
+{
+    using deferred = details::deferred_formatter<Args...>;
+    char packed[deferred::packed_size];
+    deferred::pack(packed, fmt, args...);
+    details::log_msg log_msg(source, &name_, lvl, string_view_t(packed, sizeof(packed)));
+    return sink_deferred_(log_msg, &deferred::format);
+}
+
+// some arg may refer to the caller's memory - format right away
+template<typename... Args>
+inline bool spdlog::logger::log_deferred_(std::false_type, source_loc, level::level_enum, const char *, const Args &...)
+{
+    return false;
+}
+
+#endif
+
 //
 // protected virtual called at end of each user log call (if enabled) by the
 // line_logger
@@ -421,6 +562,71 @@ inline void spdlog::logger::incr_msg_counter_(details::log_msg &msg)
     msg.msg_id = msg_counter_.fetch_add(1, std::memory_order_relaxed);
 }
 
+// a sink that isn't thread safe may only be fed by one consumer: rejected if already
+// claimed by another one (e.g. a synchronous logger's sink by an async logger's worker).
+inline std::string spdlog::logger::claim_sinks_()
+{
+    std::lock_guard<std::mutex> lock(claim_mutex_);
+    for (auto &s : sinks_)
+    {
+        auto error = claim_sink_(s);
+        if (!error.empty())
+        {
+            return error;
+        }
+    }
+    return std::string();
+}
+
+inline std::string spdlog::logger::claim_sink_(const sink_ptr &sink)
+{
+    if (sink->thread_safe() || std::find(claimed_sinks_.begin(), claimed_sinks_.end(), sink) != claimed_sinks_.end())
+    {
+        return std::string();
+    }
+    if (sinks_consumer_ != nullptr && sink->claim_consumer(sinks_consumer_))
+    {
+        claimed_sinks_.push_back(sink);
+        return std::string();
+    }
+    return "logger " + name_ + ": " +
+           (sinks_consumer_ == nullptr ? "a single threaded sink requires a thread pool with one worker per queue"
+                                       : "a single threaded sink is already fed by another thread");
+}
+
+inline void spdlog::logger::release_sinks_()
+{
+    std::lock_guard<std::mutex> lock(claim_mutex_);
+    for (auto &s : claimed_sinks_)
+    {
+        s->release_consumer(sinks_consumer_);
+    }
+    claimed_sinks_.clear();
+}
+
+inline void spdlog::logger::add_sink(sink_ptr sink)
+{
+    std::lock_guard<std::mutex> lock(claim_mutex_);
+    auto error = claim_sink_(sink);
+    if (!error.empty())
+    {
+        throw spdlog_ex(error);
+    }
+    sinks_.push_back(std::move(sink));
+}
+
+inline void spdlog::logger::remove_sink(const sink_ptr &sink)
+{
+    std::lock_guard<std::mutex> lock(claim_mutex_);
+    sinks_.erase(std::remove(sinks_.begin(), sinks_.end(), sink), sinks_.end());
+    auto claimed = std::find(claimed_sinks_.begin(), claimed_sinks_.end(), sink);
+    if (claimed != claimed_sinks_.end())
+    {
+        sink->release_consumer(sinks_consumer_);
+        claimed_sinks_.erase(claimed);
+    }
+}
+
 inline const std::vector<spdlog::sink_ptr> &spdlog::logger::sinks() const
 {
     return sinks_;
@@ -7,26 +7,42 @@
 
 // multi producer-multi consumer blocking queue.
 // enqueue(..) - will block until room found to put the new message.
-// enqueue_nowait(..) - will return immediately with false if no room left in
-// the queue.
+// enqueue_nowait(..) - will return immediately. overrun the oldest message if
+// no room left in the queue.
+// try_enqueue(..) - will return immediately with false if no room left in the
+// queue (the new message is discarded).
 // dequeue_for(..) - will block until the queue is not empty or timeout have
 // passed.
+// dequeue_bulk_for(..) - same, but pops up to max_items under a single lock.
+// try_dequeue_bulk(..) - same, but never waits (for spinning consumers).
+// size(), blocked_time() - current number of items, and the total time
+// producers waited in enqueue(..) for room.
+// resize(..) - change the capacity, keeping the queued items.
+// for_each_unsafe(..) - visit the queued items without the lock (crash_handler).
+//
+// The condition variables are only notified if some thread is actually
+// waiting on them (the waiter counts are protected by the queue mutex), so a
+// spinning consumer doesn't cost the producers a wake up call.
 
 #include "spdlog/details/circular_q.h"
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 
 namespace spdlog {
 namespace details {
 
-template<typename T>
+// Storage - circular_q<T> or any container with the same interface (e.g. slab_q<T>)
+template<typename T, typename Storage = circular_q<T>>
 class mpmc_blocking_queue
 {
 public:
     using item_type = T;
     explicit mpmc_blocking_queue(size_t max_items)
         : q_(max_items)
+        , capacity_(q_.capacity())
     {
     }
 
@@ -34,40 +50,114 @@ public:
     // try to enqueue and block if no room left
     void enqueue(T &&item)
     {
+        bool notify;
         {
             std::unique_lock<std::mutex> lock(queue_mutex_);
-            pop_cv_.wait(lock, [this] { return !this->q_.full(); });
+            wait_for_room_(lock);
             q_.push_back(std::move(item));
+            notify = consumers_waiting_ > 0;
+        }
+        if (notify)
+        {
+            push_cv_.notify_one();
         }
-        push_cv_.notify_one();
     }
 
     // enqueue immediately. overrun oldest message in the queue if no room left.
     void enqueue_nowait(T &&item)
     {
+        bool notify;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            q_.push_back(std::move(item));
+            notify = consumers_waiting_ > 0;
+        }
+        if (notify)
+        {
+            push_cv_.notify_one();
+        }
+    }
+
+    // enqueue immediately if there is room left. return false otherwise.
+    bool try_enqueue(T &&item)
+    {
+        bool notify;
         {
             std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (q_.full())
+            {
+                return false;
+            }
             q_.push_back(std::move(item));
+            notify = consumers_waiting_ > 0;
+        }
+        if (notify)
+        {
+            push_cv_.notify_one();
         }
-        push_cv_.notify_one();
+        return true;
     }
 
     // try to dequeue item. if no item found. wait upto timeout and try again
     // Return true, if succeeded dequeue item, false otherwise
     bool dequeue_for(T &popped_item, std::chrono::milliseconds wait_duration)
     {
+        size_t producers_waiting;
         {
             std::unique_lock<std::mutex> lock(queue_mutex_);
-            if (!push_cv_.wait_for(lock, wait_duration, [this] { return !this->q_.empty(); }))
+            if (!wait_for_items_(lock, wait_duration))
             {
                 return false;
             }
             q_.pop_front(popped_item);
+            producers_waiting = producers_waiting_;
         }
-        pop_cv_.notify_one();
+        notify_popped_(1, producers_waiting);
         return true;
     }
 
+    // dequeue up to max_items under a single lock. if no item found. wait upto timeout and try again
+    // stops right after an item for which stop_after(item) returns true.
+    // Return the number of dequeued items (0 if timeout passed)
+    template<typename StopPred>
+    size_t dequeue_bulk_for(T *items, size_t max_items, std::chrono::milliseconds wait_duration, StopPred stop_after)
+    {
+        size_t n = 0;
+        size_t producers_waiting;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (!wait_for_items_(lock, wait_duration))
+            {
+                return 0;
+            }
+            n = pop_bulk_(items, max_items, stop_after);
+            producers_waiting = producers_waiting_;
+        }
+        notify_popped_(n, producers_waiting);
+        return n;
+    }
+
+    // dequeue up to max_items if the lock is available, without waiting.
+    // Return the number of dequeued items
+    template<typename StopPred>
+    size_t try_dequeue_bulk(T *items, size_t max_items, StopPred stop_after)
+    {
+        size_t n = 0;
+        size_t producers_waiting;
+        {
+            // a spinning consumer shouldn't fight the producers for the lock
+            std::unique_lock<std::mutex> lock(queue_mutex_, std::try_to_lock);
+            if (!lock.owns_lock() || q_.empty())
+            {
+                return 0;
+            }
+            n = pop_bulk_(items, max_items, stop_after);
+            producers_waiting = producers_waiting_;
+        }
+        notify_popped_(n, producers_waiting);
+        return n;
+    }
+
 #else
     // apparently mingw deadlocks if the mutex is released before cv.notify_one(),
     // so release the mutex at the very end each function.
@@ -76,9 +166,12 @@ public:
     void enqueue(T &&item)
     {
         std::unique_lock<std::mutex> lock(queue_mutex_);
-        pop_cv_.wait(lock, [this] { return !this->q_.full(); });
+        wait_for_room_(lock);
         q_.push_back(std::move(item));
-        push_cv_.notify_one();
+        if (consumers_waiting_ > 0)
+        {
+            push_cv_.notify_one();
+        }
     }
 
     // enqueue immediately. overrun oldest message in the queue if no room left.
@@ -86,7 +179,26 @@ public:
     {
         std::unique_lock<std::mutex> lock(queue_mutex_);
         q_.push_back(std::move(item));
-        push_cv_.notify_one();
+        if (consumers_waiting_ > 0)
+        {
+            push_cv_.notify_one();
+        }
+    }
+
+    // enqueue immediately if there is room left. return false otherwise.
+    bool try_enqueue(T &&item)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        if (q_.full())
+        {
+            return false;
+        }
+        q_.push_back(std::move(item));
+        if (consumers_waiting_ > 0)
+        {
+            push_cv_.notify_one();
+        }
+        return true;
     }
 
     // try to dequeue item. if no item found. wait upto timeout and try again
@@ -94,15 +206,46 @@ public:
     bool dequeue_for(T &popped_item, std::chrono::milliseconds wait_duration)
     {
         std::unique_lock<std::mutex> lock(queue_mutex_);
-        if (!push_cv_.wait_for(lock, wait_duration, [this] { return !this->q_.empty(); }))
+        if (!wait_for_items_(lock, wait_duration))
         {
             return false;
         }
         q_.pop_front(popped_item);
-        pop_cv_.notify_one();
+        notify_popped_(1, producers_waiting_);
         return true;
     }
 
+    // dequeue up to max_items under a single lock. if no item found. wait upto timeout and try again
+    // stops right after an item for which stop_after(item) returns true.
+    // Return the number of dequeued items (0 if timeout passed)
+    template<typename StopPred>
+    size_t dequeue_bulk_for(T *items, size_t max_items, std::chrono::milliseconds wait_duration, StopPred stop_after)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        if (!wait_for_items_(lock, wait_duration))
+        {
+            return 0;
+        }
+        size_t n = pop_bulk_(items, max_items, stop_after);
+        notify_popped_(n, producers_waiting_);
+        return n;
+    }
+
+    // dequeue up to max_items if the lock is available, without waiting.
+    // Return the number of dequeued items
+    template<typename StopPred>
+    size_t try_dequeue_bulk(T *items, size_t max_items, StopPred stop_after)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_, std::try_to_lock);
+        if (!lock.owns_lock() || q_.empty())
+        {
+            return 0;
+        }
+        size_t n = pop_bulk_(items, max_items, stop_after);
+        notify_popped_(n, producers_waiting_);
+        return n;
+    }
+
 #endif
 
     size_t overrun_counter()
@@ -111,11 +254,120 @@ public:
         return q_.overrun_counter();
     }
 
+    size_t size()
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        return q_.size();
+    }
+
+    std::chrono::nanoseconds blocked_time()
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        return blocked_time_;
+    }
+
+    bool full()
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        return q_.full();
+    }
+
+    // doesn't take the lock
+    size_t capacity() const
+    {
+        return capacity_.load(std::memory_order_relaxed);
+    }
+
+    // never shrinks below the number of queued items.
+    // the producers are blocked meanwhile, and woken up if room was made.
+    void resize(size_t max_items)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        q_.resize(max_items);
+        capacity_.store(q_.capacity(), std::memory_order_relaxed);
+        if (producers_waiting_ > 0)
+        {
+            pop_cv_.notify_all();
+        }
+    }
+
+    // visit the queued items as fn(header, payload) - without taking the lock, so
+    // it can be called from a signal handler. items being pushed or popped
+    // meanwhile may be torn.
+    template<typename Fn>
+    void for_each_unsafe(Fn fn)
+    {
+        q_.for_each_unsafe(fn);
+    }
+
 private:
+    // the waiter counts are only accessed under the queue mutex
+    void wait_for_room_(std::unique_lock<std::mutex> &lock)
+    {
+        if (q_.full())
+        {
+            // only the slow path is timed
+            auto wait_start = std::chrono::steady_clock::now();
+            ++producers_waiting_;
+            pop_cv_.wait(lock, [this] { return !this->q_.full(); });
+            --producers_waiting_;
+            blocked_time_ += std::chrono::steady_clock::now() - wait_start;
+        }
+    }
+
+    bool wait_for_items_(std::unique_lock<std::mutex> &lock, std::chrono::milliseconds wait_duration)
+    {
+        if (!q_.empty())
+        {
+            return true;
+        }
+        ++consumers_waiting_;
+        bool found = push_cv_.wait_for(lock, wait_duration, [this] { return !this->q_.empty(); });
+        --consumers_waiting_;
+        return found;
+    }
+
+    template<typename StopPred>
+    size_t pop_bulk_(T *items, size_t max_items, StopPred stop_after)
+    {
+        size_t n = 0;
+        while (n < max_items && !q_.empty())
+        {
+            q_.pop_front(items[n]);
+            if (stop_after(items[n++]))
+            {
+                break;
+            }
+        }
+        return n;
+    }
+
+    // n slots were freed - wake as many producers blocked in enqueue()
+    void notify_popped_(size_t n, size_t producers_waiting)
+    {
+        if (producers_waiting == 0 || n == 0)
+        {
+            return;
+        }
+        if (n >= producers_waiting)
+        {
+            pop_cv_.notify_all();
+            return;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            pop_cv_.notify_one();
+        }
+    }
+
     std::mutex queue_mutex_;
     std::condition_variable push_cv_;
     std::condition_variable pop_cv_;
-    spdlog::details::circular_q<T> q_;
+    Storage q_;
+    std::atomic<size_t> capacity_;
+    size_t consumers_waiting_ = 0;
+    size_t producers_waiting_ = 0;
+    std::chrono::nanoseconds blocked_time_{0};
 };
 } // namespace details
 } // namespace spdlog
@@ -0,0 +1,402 @@
+#pragma once
+
+//
+// Copyright(c) 2019 Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+// lock-free bounded queue (array of sequence numbered slots).
+// Safe for any number of producers and consumers, but tuned for the thread
+// pool's many producers - few consumers case.
+// Producers never take a mutex. The mutex and condition variables below are
+// only touched by a consumer that found the queue empty (to park) or by a
+// producer that found it full under the block policy.
+//
+// enqueue(..) - will block until room found to put the new message.
+// enqueue_nowait(..) - will overrun the oldest message if no room left.
+// try_enqueue(..) - will return immediately with false if no room left.
+// dequeue_for(..) - will block until the queue is not empty or timeout have
+// passed.
+// try_dequeue_bulk(..) - will return immediately (for spinning consumers).
+// size(), blocked_time() - approximate number of items, and the total time
+// producers waited in enqueue(..) for room.
+// for_each_unsafe(..) - visit the queued items (crash_handler).
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+
+namespace spdlog {
+namespace details {
+
+#ifndef SPDLOG_CACHE_LINE_SIZE
+#define SPDLOG_CACHE_LINE_SIZE 64
+#endif
+
+template<typename T>
+class mpmc_lockfree_queue
+{
+public:
+    using item_type = T;
+
+    // capacity is max_items rounded up to the next power of 2
+    explicit mpmc_lockfree_queue(size_t max_items)
+        : mask_(round_up_pow2_(max_items) - 1)
+        , storage_(new char[(mask_ + 1) * sizeof(slot) + SPDLOG_CACHE_LINE_SIZE])
+    {
+        // new[] only aligns for the fundamental types - start the slots on a cache line
+        const auto line = static_cast<std::uintptr_t>(SPDLOG_CACHE_LINE_SIZE);
+        const auto addr = reinterpret_cast<std::uintptr_t>(storage_.get());
+        slots_ = reinterpret_cast<slot *>((addr + line - 1) & ~(line - 1));
+        size_t constructed = 0;
+        try
+        {
+            for (; constructed <= mask_; constructed++)
+            {
+                new (&slots_[constructed]) slot();
+                slots_[constructed].seq.store(constructed, std::memory_order_relaxed);
+            }
+        }
+        catch (...)
+        {
+            destroy_slots_(constructed);
+            throw;
+        }
+    }
+
+    ~mpmc_lockfree_queue()
+    {
+        destroy_slots_(mask_ + 1);
+    }
+
+    mpmc_lockfree_queue(const mpmc_lockfree_queue &) = delete;
+    mpmc_lockfree_queue &operator=(const mpmc_lockfree_queue &) = delete;
+
+    // try to enqueue and block if no room left
+    void enqueue(T &&item)
+    {
+        if (!try_push_(item))
+        {
+            wait_for_room_(item);
+        }
+        notify_consumer_();
+    }
+
+    // enqueue immediately. overrun oldest message in the queue if no room left.
+    void enqueue_nowait(T &&item)
+    {
+        while (!try_push_(item))
+        {
+            T overrun_item;
+            if (try_pop_(overrun_item))
+            {
+                overrun_counter_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        notify_consumer_();
+    }
+
+    // enqueue immediately if there is room left. return false otherwise.
+    bool try_enqueue(T &&item)
+    {
+        if (!try_push_(item))
+        {
+            return false;
+        }
+        notify_consumer_();
+        return true;
+    }
+
+    // try to dequeue item. if no item found. wait upto timeout and try again
+    // Return true, if succeeded dequeue item, false otherwise
+    bool dequeue_for(T &popped_item, std::chrono::milliseconds wait_duration)
+    {
+        if (!pop_or_park_(popped_item, wait_duration))
+        {
+            return false;
+        }
+        notify_producers_(1);
+        return true;
+    }
+
+    // dequeue up to max_items. if no item found. wait upto timeout and try again
+    // stops right after an item for which stop_after(item) returns true.
+    // Return the number of dequeued items (0 if timeout passed)
+    template<typename StopPred>
+    size_t dequeue_bulk_for(T *items, size_t max_items, std::chrono::milliseconds wait_duration, StopPred stop_after)
+    {
+        if (max_items == 0 || !pop_or_park_(items[0], wait_duration))
+        {
+            return 0;
+        }
+        size_t n = 1;
+        if (!stop_after(items[0]))
+        {
+            while (n < max_items && try_pop_(items[n]))
+            {
+                if (stop_after(items[n++]))
+                {
+                    break;
+                }
+            }
+        }
+        notify_producers_(n);
+        return n;
+    }
+
+    // dequeue up to max_items without waiting (for spinning consumers).
+    // Return the number of dequeued items
+    template<typename StopPred>
+    size_t try_dequeue_bulk(T *items, size_t max_items, StopPred stop_after)
+    {
+        size_t n = 0;
+        while (n < max_items && try_pop_(items[n]))
+        {
+            if (stop_after(items[n++]))
+            {
+                break;
+            }
+        }
+        if (n > 0)
+        {
+            notify_producers_(n);
+        }
+        return n;
+    }
+
+    size_t overrun_counter()
+    {
+        return overrun_counter_.load(std::memory_order_relaxed);
+    }
+
+    // a snapshot of two moving positions - may be off while items are in flight
+    size_t size()
+    {
+        size_t dequeue_pos = dequeue_pos_.load(std::memory_order_relaxed);
+        size_t enqueue_pos = enqueue_pos_.load(std::memory_order_relaxed);
+        auto diff = static_cast<std::intptr_t>(enqueue_pos) - static_cast<std::intptr_t>(dequeue_pos);
+        if (diff <= 0)
+        {
+            return 0;
+        }
+        return (std::min)(static_cast<size_t>(diff), mask_ + 1);
+    }
+
+    size_t capacity() const
+    {
+        return mask_ + 1;
+    }
+
+    std::chrono::nanoseconds blocked_time()
+    {
+        return std::chrono::nanoseconds(blocked_ns_.load(std::memory_order_relaxed));
+    }
+
+    // visit the published items from the oldest as fn(header, payload), without
+    // popping them. lock free, so it can be called from a signal handler - an item
+    // popped meanwhile may be torn.
+    template<typename Fn>
+    void for_each_unsafe(Fn fn)
+    {
+        const size_t enqueue_pos = enqueue_pos_.load(std::memory_order_acquire);
+        for (size_t pos = dequeue_pos_.load(std::memory_order_acquire); pos != enqueue_pos; pos++)
+        {
+            slot &s = slots_[pos & mask_];
+            if (s.seq.load(std::memory_order_acquire) == pos + 1)
+            {
+                fn(s.item, s.item.payload());
+            }
+        }
+    }
+
+private:
+    // each slot is padded to whole cache lines so producers writing adjacent
+    // slots don't invalidate each other's line.
+    struct slot
+    {
+        std::atomic<size_t> seq;
+        T item;
+        char pad_[SPDLOG_CACHE_LINE_SIZE - (sizeof(std::atomic<size_t>) + sizeof(T)) % SPDLOG_CACHE_LINE_SIZE];
+    };
+    static_assert(sizeof(slot) % SPDLOG_CACHE_LINE_SIZE == 0, "each slot must start on a cache line");
+
+    void destroy_slots_(size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            slots_[i].~slot();
+        }
+    }
+
+    static size_t round_up_pow2_(size_t n)
+    {
+        size_t rv = 2;
+        while (rv < n)
+        {
+            rv <<= 1;
+        }
+        return rv;
+    }
+
+    // Vyukov's bounded queue: a slot is free for position pos when its seq equals
+    // pos, and holds an item for position pos when its seq equals pos + 1.
+    bool try_push_(T &item)
+    {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        slot *s;
+        for (;;)
+        {
+            s = &slots_[pos & mask_];
+            size_t seq = s->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        s->item = std::move(item);
+        s->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop_(T &popped_item)
+    {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        slot *s;
+        for (;;)
+        {
+            s = &slots_[pos & mask_];
+            size_t seq = s->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // empty
+            }
+            else
+            {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        popped_item = std::move(s->item);
+        s->seq.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    // pop an item, or park until one is pushed or timeout have passed
+    bool pop_or_park_(T &popped_item, std::chrono::milliseconds wait_duration)
+    {
+        if (try_pop_(popped_item))
+        {
+            return true;
+        }
+        std::unique_lock<std::mutex> lock(park_mutex_);
+        consumers_waiting_.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool popped = push_cv_.wait_for(lock, wait_duration, [&] { return this->try_pop_(popped_item); });
+        consumers_waiting_.fetch_sub(1, std::memory_order_relaxed);
+        return popped;
+    }
+
+    // slow path of enqueue(): spin shortly, then park until a consumer frees a slot.
+    void wait_for_room_(T &item)
+    {
+        auto wait_start = std::chrono::steady_clock::now();
+        bool pushed = false;
+        for (int i = 0; i < 64 && !pushed; i++)
+        {
+            std::this_thread::yield();
+            pushed = try_push_(item);
+        }
+        if (!pushed)
+        {
+            std::unique_lock<std::mutex> lock(park_mutex_);
+            producers_waiting_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            pop_cv_.wait(lock, [&] { return this->try_push_(item); });
+            producers_waiting_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - wait_start);
+        blocked_ns_.fetch_add(static_cast<uint64_t>(waited.count()), std::memory_order_relaxed);
+    }
+
+    // only pay for the mutex and the futex wake if someone is actually parked.
+    // the fences pair with the ones in the parking paths, so either the parked
+    // side sees our update in its predicate or we see it waiting.
+    void notify_consumer_()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (consumers_waiting_.load(std::memory_order_relaxed) > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(park_mutex_);
+            }
+            push_cv_.notify_one();
+        }
+    }
+
+    // wake as many parked producers as slots were freed
+    void notify_producers_(size_t freed)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const size_t waiting = producers_waiting_.load(std::memory_order_relaxed);
+        if (waiting > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(park_mutex_);
+            }
+            if (freed >= waiting)
+            {
+                pop_cv_.notify_all();
+                return;
+            }
+            for (size_t i = 0; i < freed; i++)
+            {
+                pop_cv_.notify_one();
+            }
+        }
+    }
+
+    const size_t mask_;
+    std::unique_ptr<char[]> storage_;
+    slot *slots_ = nullptr; // in storage_, cache line aligned
+
+    char pad0_[SPDLOG_CACHE_LINE_SIZE];
+    std::atomic<size_t> enqueue_pos_{0};
+    char pad1_[SPDLOG_CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> dequeue_pos_{0};
+    char pad2_[SPDLOG_CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+
+    std::atomic<size_t> consumers_waiting_{0};
+    std::atomic<size_t> producers_waiting_{0};
+    std::atomic<size_t> overrun_counter_{0};
+    std::atomic<uint64_t> blocked_ns_{0};
+    std::mutex park_mutex_;
+    std::condition_variable push_cv_;
+    std::condition_variable pop_cv_;
+};
+} // namespace details
+} // namespace spdlog
@@ -17,6 +17,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <thread>
+#include <vector>
 
 #ifdef _WIN32
 
@@ -38,6 +39,9 @@
 #else // unix
 
 #include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
 #include <unistd.h>
 
 #ifdef __linux__
@@ -53,6 +57,13 @@
 #define __has_feature(x) 0 // Compatibility with non-clang compilers.
 #endif
 
+#if defined(SPDLOG_CLOCK_TSC)
+#if defined(SPDLOG_CLOCK_COARSE)
+#error "SPDLOG_CLOCK_TSC and SPDLOG_CLOCK_COARSE are mutually exclusive"
+#endif
+#include "spdlog/details/tsc_clock.h"
+#endif
+
 namespace spdlog {
 namespace details {
 namespace os {
@@ -60,7 +71,10 @@ namespace os {
 inline spdlog::log_clock::time_point now() SPDLOG_NOEXCEPT
 {
 
-#if defined __linux__ && defined SPDLOG_CLOCK_COARSE
+#if defined(SPDLOG_CLOCK_TSC)
+    return tsc_clock::now();
+
+#elif defined __linux__ && defined SPDLOG_CLOCK_COARSE
     timespec ts;
     ::clock_gettime(CLOCK_REALTIME_COARSE, &ts);
     return std::chrono::time_point<log_clock, typename log_clock::duration>(
@@ -200,6 +214,16 @@ inline bool file_exists(const filename_t &filename) SPDLOG_NOEXCEPT
 #endif
 }
 
+// Return the file descriptor of an open FILE* object
+inline int file_descriptor(FILE *f) SPDLOG_NOEXCEPT
+{
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    return _fileno(f);
+#else
+    return fileno(f);
+#endif
+}
+
 // Return file size according to open FILE* object
 inline size_t filesize(FILE *f)
 {
@@ -357,6 +381,104 @@ inline void sleep_for_millis(int milliseconds) SPDLOG_NOEXCEPT
 #endif
 }
 
+// pin the calling thread to the given cpus.
+// return false if failed or not supported on this platform.
+inline bool set_thread_affinity(const std::vector<int> &cpus) SPDLOG_NOEXCEPT
+{
+#if defined(_WIN32)
+    DWORD_PTR mask = 0;
+    for (int cpu : cpus)
+    {
+        if (cpu < 0 || cpu >= static_cast<int>(sizeof(mask) * 8))
+        {
+            return false;
+        }
+        mask |= static_cast<DWORD_PTR>(1) << cpu;
+    }
+    return ::SetThreadAffinityMask(::GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+    {
+        if (cpu < 0 || cpu >= CPU_SETSIZE)
+        {
+            return false;
+        }
+        CPU_SET(cpu, &set);
+    }
+    return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+// name the calling thread (as shown by debuggers, top -H, etc.)
+// the name may be truncated (e.g. to 15 chars on linux).
+// return false if failed or not supported on this platform.
+inline bool set_thread_name(const std::string &name)
+{
+#if defined(_WIN32)
+    // SetThreadDescription() is only available since windows 10 1607
+    using set_thread_description_t = HRESULT(WINAPI *)(HANDLE, PCWSTR);
+    auto set_thread_description =
+        reinterpret_cast<set_thread_description_t>(::GetProcAddress(::GetModuleHandleW(L"kernel32.dll"), "SetThreadDescription"));
+    if (set_thread_description == nullptr)
+    {
+        return false;
+    }
+    std::wstring wname(name.begin(), name.end());
+    return SUCCEEDED(set_thread_description(::GetCurrentThread(), wname.c_str()));
+#elif defined(__APPLE__)
+    return ::pthread_setname_np(name.substr(0, 63).c_str()) == 0;
+#elif defined(__linux__)
+    return ::pthread_setname_np(::pthread_self(), name.substr(0, 15).c_str()) == 0;
+#else
+    (void)name;
+    return false;
+#endif
+}
+
+// set the scheduling policy (SCHED_*) and priority of the calling thread.
+// return false if failed or not supported on this platform.
+inline bool set_thread_sched(int policy, int priority) SPDLOG_NOEXCEPT
+{
+#if defined(_WIN32)
+    (void)policy;
+    (void)priority;
+    return false;
+#else
+    sched_param param{};
+    param.sched_priority = priority;
+    return ::pthread_setschedparam(::pthread_self(), policy, &param) == 0;
+#endif
+}
+
+// set the nice value of the calling thread (linux only).
+// return false if failed or not supported on this platform.
+inline bool set_thread_nice(int nice) SPDLOG_NOEXCEPT
+{
+#if defined(__linux__)
+    return ::setpriority(PRIO_PROCESS, static_cast<id_t>(::syscall(SYS_gettid)), nice) == 0;
+#else
+    (void)nice;
+    return false;
+#endif
+}
+
+// hint the cpu that we are busy waiting (e.g. so it can run the sibling hyper thread)
+inline void cpu_relax() SPDLOG_NOEXCEPT
+{
+#if defined(_WIN32)
+    YieldProcessor();
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__i386__) || defined(__x86_64__))
+    __builtin_ia32_pause();
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
 // wchar support for windows file names (SPDLOG_WCHAR_FILENAMES must be defined)
 #if defined(_WIN32) && defined(SPDLOG_WCHAR_FILENAMES)
 #define SPDLOG_FILENAME_T(s) L##s
@@ -0,0 +1,268 @@
+#pragma once
+
+//
+// Copyright(c) 2019 Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+// severity ordered lanes for the (mutex protected) async queue.
+// Same interface as circular_q, so it can back mpmc_blocking_queue.
+// Each item goes to the lane of its T::priority_lane(), and pop_front() takes
+// the oldest item of the highest non empty lane.
+//
+// Lane 0 is the ordered lane (e.g. for control msgs): its front item is only
+// popped once every older item of the other lanes was popped - those are still
+// popped highest lane first. It's also the last lane to be overrun, so its
+// items are never dropped while older items of the other lanes wait.
+//
+// The lanes share one capacity of max_items. When it is reached, push_back()
+// overruns the oldest item of the lowest non empty lane - or the new item
+// itself if its lane is lower than that.
+// The lanes also share their memory: each starts with max_items / lanes_n, and
+// a full lane grows into the room the other lanes don't use, which shrink to
+// their items if needed. Their capacities add up to at most 1.5 * max_items
+// (plus one item per lane).
+//
+// Not thread safe - protected by the owning queue's mutex.
+
+#include "spdlog/details/circular_q.h"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+
+namespace spdlog {
+namespace details {
+
+template<typename T, typename Lane = circular_q<T>>
+class priority_q
+{
+public:
+    using item_type = T;
+    static const size_t lanes_n = T::priority_lanes;
+
+    explicit priority_q(size_t max_items)
+        : capacity_(max_items)
+    {
+        for (auto &lane : lanes_)
+        {
+            lane.reset(new Lane(share_()));
+        }
+    }
+
+    // push back, overrun the oldest item of the lowest lane if no room left
+    void push_back(T &&item)
+    {
+        const size_t lane = item.priority_lane();
+        if (size() >= capacity_)
+        {
+            const size_t victim = lowest_non_empty_();
+            if (lane != 0 && lane < victim)
+            {
+                ++overrun_counter_; // discard the new item, it's the least severe
+                return;
+            }
+            drop_front_(victim);
+        }
+        while (lanes_[lane]->full() && !grow_(lane))
+        {
+            drop_front_(lane); // full on its own at the whole capacity (e.g. a slab_q lane of big records)
+        }
+        item.queue_seq = next_seq_++;
+        lanes_[lane]->push_back(std::move(item));
+    }
+
+    // Pop the oldest item of the highest non empty lane (see the ordered lane above).
+    // If there are no elements in the container, the behavior is undefined.
+    void pop_front(T &popped_item)
+    {
+        const bool ordered = !lanes_[0]->empty();
+        const size_t ordered_seq = ordered ? lanes_[0]->front().queue_seq : 0;
+        for (size_t i = lanes_n; i-- > 1;)
+        {
+            if (!lanes_[i]->empty() && (!ordered || lanes_[i]->front().queue_seq < ordered_seq))
+            {
+                lanes_[i]->pop_front(popped_item);
+                return;
+            }
+        }
+        lanes_[0]->pop_front(popped_item);
+    }
+
+    bool empty()
+    {
+        for (auto &lane : lanes_)
+        {
+            if (!lane->empty())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // true if the capacity is reached, or if any lane is full on its own and can't grow
+    // (push_back() grows the full lanes that can)
+    bool full() const
+    {
+        if (size() >= capacity_)
+        {
+            return true;
+        }
+        for (size_t i = 0; i < lanes_n; i++)
+        {
+            if (lanes_[i]->full() && !can_grow_(i))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t size() const
+    {
+        size_t rv = 0;
+        for (auto &lane : lanes_)
+        {
+            rv += lane->size();
+        }
+        return rv;
+    }
+
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    // never shrinks below the current number of items
+    void resize(size_t max_items)
+    {
+        capacity_ = (std::max)(max_items, size());
+        for (auto &lane : lanes_)
+        {
+            lane->resize((std::max)(lane->size(), share_()));
+        }
+    }
+
+    size_t overrun_counter() const
+    {
+        return overrun_counter_;
+    }
+
+    // visit the items lane by lane (highest first) as fn(header, payload).
+    // for crash_handler only: the caller owns the queue or every other thread is stopped.
+    template<typename Fn>
+    void for_each_unsafe(Fn fn)
+    {
+        for (size_t i = lanes_n; i-- > 0;)
+        {
+            lanes_[i]->for_each_unsafe(fn);
+        }
+    }
+
+private:
+    // lowest non empty lane, lane 0 last. called when full, so there is one.
+    size_t lowest_non_empty_()
+    {
+        for (size_t i = 1; i < lanes_n; i++)
+        {
+            if (!lanes_[i]->empty())
+            {
+                return i;
+            }
+        }
+        return 0;
+    }
+
+    // initial capacity of each lane
+    size_t share_() const
+    {
+        return (std::max)(capacity_ / lanes_n, size_t(1));
+    }
+
+    // max total capacity of the lanes
+    size_t budget_() const
+    {
+        return capacity_ + capacity_ / 2 + lanes_n;
+    }
+
+    size_t lanes_capacity_() const
+    {
+        size_t rv = 0;
+        for (auto &lane : lanes_)
+        {
+            rv += lane->capacity();
+        }
+        return rv;
+    }
+
+    // grow a full lane (up to the whole capacity) within the budget, shrinking the
+    // other lanes to their items - or to their share - if needed.
+    // return false if the lane can't grow.
+    bool grow_(size_t lane)
+    {
+        const size_t current = lanes_[lane]->capacity();
+        if (current >= capacity_)
+        {
+            return false;
+        }
+        const size_t wanted = (std::min)(capacity_, (std::max)(current * 2, current + 1));
+        for (int pass = 0; pass < 2 && lanes_capacity_() - current + wanted > budget_(); pass++)
+        {
+            for (size_t i = 0; i < lanes_n; i++)
+            {
+                const size_t items = lanes_[i]->size();
+                const size_t shrunk = pass == 0 ? (std::max)(items, share_()) : (std::max)(items, size_t(1));
+                if (i != lane && lanes_[i]->capacity() > shrunk)
+                {
+                    lanes_[i]->resize(shrunk);
+                }
+            }
+        }
+        const size_t others = lanes_capacity_() - current;
+        const size_t room = budget_() > others ? budget_() - others : 0;
+        if ((std::min)(wanted, room) <= current)
+        {
+            return false;
+        }
+        lanes_[lane]->resize((std::min)(wanted, room));
+        return true;
+    }
+
+    // whether grow_(lane) would succeed, i.e. the lane fits in the budget with more room
+    // than now once the other lanes are shrunk to their items.
+    // exact for circular_q lanes. a slab_q lane can't shrink below the bytes of its
+    // records, so a lane of big records may grow less than estimated here - and still
+    // be overrun by push_back() once grown.
+    bool can_grow_(size_t lane) const
+    {
+        const size_t current = lanes_[lane]->capacity();
+        if (current >= capacity_)
+        {
+            return false;
+        }
+        size_t others = 0;
+        for (size_t i = 0; i < lanes_n; i++)
+        {
+            if (i != lane)
+            {
+                others += (std::min)(lanes_[i]->capacity(), (std::max)(lanes_[i]->size(), size_t(1)));
+            }
+        }
+        return budget_() > others && budget_() - others > current;
+    }
+
+    void drop_front_(size_t lane)
+    {
+        T overrun_item;
+        lanes_[lane]->pop_front(overrun_item);
+        ++overrun_counter_;
+    }
+
+    size_t capacity_;
+    std::unique_ptr<Lane> lanes_[lanes_n];
+    size_t next_seq_ = 0;
+    size_t overrun_counter_ = 0;
+};
+} // namespace details
+} // namespace spdlog
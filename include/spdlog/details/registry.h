@@ -11,6 +11,7 @@
 // This class is thread safe
 
 #include "spdlog/common.h"
+#include "spdlog/details/call_site_limiter.h"
 #include "spdlog/details/periodic_worker.h"
 #include "spdlog/logger.h"
 
@@ -177,25 +178,40 @@ public:
         std::lock_guard<std::mutex> lock(logger_map_mutex_);
         for (auto &l : loggers_)
         {
+            call_site_limiter::log_suppressed(*l.second);
             l.second->flush();
         }
     }
 
+    // the dropped loggers are released after the registry lock: an async
+    // logger's destructor waits for its pending messages to be processed.
     void drop(const std::string &logger_name)
     {
-        std::lock_guard<std::mutex> lock(logger_map_mutex_);
-        loggers_.erase(logger_name);
-        if (default_logger_ && default_logger_->name() == logger_name)
+        std::shared_ptr<logger> dropped_logger, dropped_default;
         {
-            default_logger_.reset();
+            std::lock_guard<std::mutex> lock(logger_map_mutex_);
+            auto found = loggers_.find(logger_name);
+            if (found != loggers_.end())
+            {
+                dropped_logger = std::move(found->second);
+                loggers_.erase(found);
+            }
+            if (default_logger_ && default_logger_->name() == logger_name)
+            {
+                dropped_default = std::move(default_logger_);
+            }
         }
     }
 
     void drop_all()
     {
-        std::lock_guard<std::mutex> lock(logger_map_mutex_);
-        loggers_.clear();
-        default_logger_.reset();
+        std::unordered_map<std::string, std::shared_ptr<logger>> dropped_loggers;
+        std::shared_ptr<logger> dropped_default;
+        {
+            std::lock_guard<std::mutex> lock(logger_map_mutex_);
+            loggers_.swap(dropped_loggers);
+            dropped_default = std::move(default_logger_);
+        }
     }
 
     // clean all resources and threads started by the registry
@@ -206,12 +222,17 @@ public:
             periodic_flusher_.reset();
         }
 
+        apply_all([](const std::shared_ptr<logger> l) { call_site_limiter::log_suppressed(*l); });
         drop_all();
 
         {
             std::lock_guard<std::recursive_mutex> lock(tp_mutex_);
             tp_.reset();
         }
+
+#if defined(SPDLOG_CLOCK_TSC)
+        tsc_clock::stop_calibration();
+#endif
     }
 
     std::recursive_mutex &tp_mutex()
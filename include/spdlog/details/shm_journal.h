@@ -0,0 +1,356 @@
+#pragma once
+
+//
+// Copyright(c) 2019 Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+// journal of the async log msgs in a shared memory object (thread_pool_options::shm_journal).
+// Each log msg posted to the thread pool is also copied to the next record of a
+// ring in a shm_open() mapping, and marked consumed once a worker thread wrote
+// it to the sinks. The mapping outlives a crashed process, so the records it
+// committed but never consumed can be read back by a sidecar process or by the
+// next start of the same binary (see recover() and spdlog::recover_async_journal()).
+//
+// The layout is fixed and position independent - fixed size integers and
+// offsets only - so any process of the same architecture can read it:
+//   header | capacity records of record_size bytes
+// Each record holds the msg's time, level, thread id, logger name and payload,
+// truncated to fit the record (SPDLOG_SHM_JOURNAL_RECORD_SIZE).
+// A record still unconsumed when its slot comes around again (capacity msgs
+// later), or still being written by another thread, is left alone: the new msg
+// is not journaled then.
+// A msg is consumed once its sink calls returned, so the msg being written at
+// the time of a crash is recovered too, while the ones still in a sink's stdio
+// buffer are not. A msg dropped by the thread pool (overflow policy, shutdown)
+// is consumed when dropped - see shm_journal_record.
+// An existing journal of the same name is never replaced: recover it first.
+//
+// Compiled in with SPDLOG_ASYNC_SHM_JOURNAL. Posix only (link with -lrt on older glibc).
+
+#include "spdlog/common.h"
+#include "spdlog/details/log_msg.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef SPDLOG_SHM_JOURNAL_RECORD_SIZE
+#define SPDLOG_SHM_JOURNAL_RECORD_SIZE 512
+#endif
+
+namespace spdlog {
+namespace details {
+
+class shm_journal
+{
+public:
+    static const size_t record_size = SPDLOG_SHM_JOURNAL_RECORD_SIZE;
+
+    // create the journal with room for capacity records.
+    // throws if a journal of that name exists - e.g. left by a crashed process, see recover().
+    shm_journal(const std::string &name, size_t capacity)
+        : name_(name)
+    {
+#ifndef _WIN32
+        if (capacity == 0)
+        {
+            throw spdlog_ex("shm_journal: invalid capacity 0");
+        }
+        int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd == -1 && errno == EEXIST)
+        {
+            throw spdlog_ex("shm_journal: " + name + " already exists (recover it first, see spdlog::recover_async_journal())");
+        }
+        if (fd == -1)
+        {
+            throw spdlog_ex("shm_journal: failed creating " + name, errno);
+        }
+        size_ = sizeof(header) + capacity * record_size;
+        void *mapped = MAP_FAILED;
+        if (::ftruncate(fd, static_cast<off_t>(size_)) == 0)
+        {
+            mapped = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        const int last_errno = errno;
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+        {
+            ::shm_unlink(name.c_str());
+            throw spdlog_ex("shm_journal: failed mapping " + name, last_errno);
+        }
+        base_ = static_cast<char *>(mapped);
+
+        // the new mapping is zero filled: every record is empty
+        auto *h = new (base_) header();
+        if (!h->next_pos.is_lock_free())
+        {
+            ::munmap(base_, size_);
+            base_ = nullptr;
+            remove();
+            throw spdlog_ex("shm_journal: no lock free 64 bit atomics on this platform");
+        }
+        h->version = version;
+        h->record_size = static_cast<uint32_t>(record_size);
+        h->capacity = capacity;
+        std::memcpy(h->magic, magic_(), sizeof(h->magic));
+#else
+        (void)capacity;
+        throw spdlog_ex("shm_journal: not supported on this platform");
+#endif
+    }
+
+    shm_journal(const shm_journal &) = delete;
+    shm_journal &operator=(const shm_journal &) = delete;
+
+    // the shared memory object stays (e.g. for recover()) unless remove() was called
+    ~shm_journal()
+    {
+#ifndef _WIN32
+        if (base_ != nullptr)
+        {
+            ::munmap(base_, size_);
+        }
+#endif
+    }
+
+    // delete the shared memory object (e.g. once all its records were consumed)
+    void remove()
+    {
+#ifndef _WIN32
+        ::shm_unlink(name_.c_str());
+#endif
+    }
+
+    // copy a log msg to the next record. return its id for consume(), or 0 if the
+    // record is still in use (not consumed yet, or being written).
+    uint64_t append(const log_msg &msg, string_view_t payload)
+    {
+        auto *h = reinterpret_cast<header *>(base_);
+        const uint64_t pos = h->next_pos.fetch_add(1, std::memory_order_relaxed);
+        record *rec = record_at_(pos, h->capacity);
+        uint64_t tag = rec->tag.load(std::memory_order_relaxed);
+        if ((tag != 0 && tag % 4 != consumed) || !rec->tag.compare_exchange_strong(tag, pos * 4 + writing, std::memory_order_acquire))
+        {
+            return 0;
+        }
+
+        rec->time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(msg.time.time_since_epoch()).count();
+        rec->thread_id = msg.thread_id;
+        rec->level = static_cast<uint32_t>(msg.level);
+        const size_t room = record_size - sizeof(record);
+        const size_t name_size = msg.logger_name == nullptr ? 0 : (std::min)(msg.logger_name->size(), room);
+        const size_t payload_size = (std::min)(payload.size(), room - name_size);
+        char *data = reinterpret_cast<char *>(rec) + sizeof(record);
+        if (name_size > 0)
+        {
+            std::memcpy(data, msg.logger_name->data(), name_size);
+        }
+        std::memcpy(data + name_size, payload.data(), payload_size);
+        rec->name_size = static_cast<uint32_t>(name_size);
+        rec->payload_size = static_cast<uint32_t>(payload_size);
+
+        rec->tag.store(pos * 4 + committed, std::memory_order_release);
+        return pos + 1;
+    }
+
+    // mark the record of id (returned by append()) as consumed
+    void consume(uint64_t id)
+    {
+        const uint64_t pos = id - 1;
+        record *rec = record_at_(pos, reinterpret_cast<header *>(base_)->capacity);
+        uint64_t tag = pos * 4 + committed;
+        rec->tag.compare_exchange_strong(tag, pos * 4 + consumed, std::memory_order_release, std::memory_order_relaxed);
+    }
+
+    // visit the records of the journal name committed but never consumed, oldest first, as fn(log_msg).
+    // remove_after - delete the journal once read.
+    // return the number of records visited (0 if there is no such journal or it's not valid).
+    static size_t recover(const std::string &name, const std::function<void(const log_msg &)> &fn, bool remove_after = true)
+    {
+        size_t rv = 0;
+#ifndef _WIN32
+        int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd == -1)
+        {
+            return 0;
+        }
+        struct stat st;
+        void *mapped = MAP_FAILED;
+        size_t size = 0;
+        if (::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(header))
+        {
+            size = static_cast<size_t>(st.st_size);
+            mapped = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+        {
+            return 0;
+        }
+
+        const char *base = static_cast<const char *>(mapped);
+        auto *h = reinterpret_cast<const header *>(base);
+        if (std::memcmp(h->magic, magic_(), sizeof(h->magic)) == 0 && h->version == version && h->record_size >= sizeof(record) &&
+            h->capacity <= (size - sizeof(header)) / h->record_size)
+        {
+            // the committed records, by position
+            std::vector<std::pair<uint64_t, const record *>> pending;
+            for (uint64_t i = 0; i < h->capacity; i++)
+            {
+                auto *rec = reinterpret_cast<const record *>(base + sizeof(header) + i * h->record_size);
+                const uint64_t tag = rec->tag.load(std::memory_order_acquire);
+                if (tag % 4 == committed && rec->level <= static_cast<uint32_t>(level::off))
+                {
+                    pending.emplace_back(tag / 4, rec);
+                }
+            }
+            std::sort(pending.begin(), pending.end(),
+                [](const std::pair<uint64_t, const record *> &a, const std::pair<uint64_t, const record *> &b) { return a.first < b.first; });
+
+            const size_t room = h->record_size - sizeof(record);
+            std::string logger_name;
+            for (auto &p : pending)
+            {
+                const record *rec = p.second;
+                const char *data = reinterpret_cast<const char *>(rec) + sizeof(record);
+                const size_t name_size = (std::min)(static_cast<size_t>(rec->name_size), room);
+                const size_t payload_size = (std::min)(static_cast<size_t>(rec->payload_size), room - name_size);
+                logger_name.assign(data, name_size);
+                log_msg msg(&logger_name, static_cast<level::level_enum>(rec->level), string_view_t(data + name_size, payload_size));
+                msg.time = log_clock::time_point(std::chrono::duration_cast<log_clock::duration>(std::chrono::nanoseconds(rec->time_ns)));
+                msg.thread_id = static_cast<size_t>(rec->thread_id);
+                fn(msg);
+                ++rv;
+            }
+        }
+        ::munmap(mapped, size);
+        if (remove_after)
+        {
+            ::shm_unlink(name.c_str());
+        }
+#else
+        (void)name;
+        (void)fn;
+        (void)remove_after;
+#endif
+        return rv;
+    }
+
+private:
+    static const uint32_t version = 1;
+
+    // record states (the 2 low bits of record::tag)
+    static const uint64_t writing = 1;
+    static const uint64_t committed = 2;
+    static const uint64_t consumed = 3;
+
+    struct header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t record_size;
+        uint64_t capacity;
+        std::atomic<uint64_t> next_pos{0};
+    };
+
+    // followed by the logger name and the payload
+    struct record
+    {
+        // position * 4 + state (0 if never written)
+        std::atomic<uint64_t> tag;
+        int64_t time_ns;
+        uint64_t thread_id;
+        uint32_t level;
+        uint32_t name_size;
+        uint32_t payload_size;
+        uint32_t reserved;
+    };
+
+    static_assert(SPDLOG_SHM_JOURNAL_RECORD_SIZE > sizeof(record) && SPDLOG_SHM_JOURNAL_RECORD_SIZE % 8 == 0,
+        "SPDLOG_SHM_JOURNAL_RECORD_SIZE must be a multiple of 8 bigger than the record header");
+
+    static const char *magic_()
+    {
+        return "SPDLOGJ1";
+    }
+
+    record *record_at_(uint64_t pos, uint64_t capacity)
+    {
+        return reinterpret_cast<record *>(base_ + sizeof(header) + (pos % capacity) * record_size);
+    }
+
+    std::string name_;
+    char *base_ = nullptr;
+    size_t size_ = 0;
+};
+
+// the record of a queued msg, consumed when the msg was written to the sinks - or when
+// the msg is destroyed or overwritten without being processed (e.g. overrun in the queue,
+// discarded, abandoned by thread_pool::shutdown()). only a crash leaves records unconsumed.
+class shm_journal_record
+{
+public:
+    shm_journal_record() = default;
+
+    shm_journal_record(shm_journal *journal, uint64_t id)
+        : journal_(id != 0 ? journal : nullptr)
+        , id_(id)
+    {
+    }
+
+    shm_journal_record(const shm_journal_record &) = delete;
+    shm_journal_record &operator=(const shm_journal_record &) = delete;
+
+    shm_journal_record(shm_journal_record &&other) SPDLOG_NOEXCEPT : journal_(other.journal_), id_(other.id_)
+    {
+        other.journal_ = nullptr;
+    }
+
+    shm_journal_record &operator=(shm_journal_record &&other) SPDLOG_NOEXCEPT
+    {
+        if (this != &other)
+        {
+            consume();
+            journal_ = other.journal_;
+            id_ = other.id_;
+            other.journal_ = nullptr;
+        }
+        return *this;
+    }
+
+    ~shm_journal_record()
+    {
+        consume();
+    }
+
+    void consume()
+    {
+        if (journal_ != nullptr)
+        {
+            journal_->consume(id_);
+            journal_ = nullptr;
+        }
+    }
+
+private:
+    shm_journal *journal_ = nullptr;
+    uint64_t id_ = 0;
+};
+} // namespace details
+} // namespace spdlog
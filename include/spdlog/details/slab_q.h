@@ -0,0 +1,300 @@
+#pragma once
+
+//
+// Copyright(c) 2019 Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+// circular byte arena of variable length async msg records.
+// Same interface as circular_q, so it can back mpmc_blocking_queue instead of
+// the vector of pre-constructed async_msg slots.
+// Each record is the msg header followed by the payload, written inline at its
+// exact size. Payloads bigger than SPDLOG_ASYNC_SLAB_MAX_PAYLOAD are kept on
+// the heap and only their address is stored in the arena.
+//
+// Not thread safe - protected by the owning queue's mutex.
+
+#include "spdlog/common.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+
+#ifndef SPDLOG_ASYNC_SLAB_MAX_PAYLOAD
+#define SPDLOG_ASYNC_SLAB_MAX_PAYLOAD 512
+#endif
+
+namespace spdlog {
+namespace details {
+
+template<typename T>
+class slab_q
+{
+public:
+    using item_type = T;
+    using header_type = typename T::header_type;
+
+    // the arena has room for max_items records of 64 bytes payload
+    explicit slab_q(size_t max_items)
+        : capacity_(arena_size_(max_items))
+        , buf_(new char[capacity_])
+    {
+    }
+
+    slab_q(const slab_q &) = delete;
+    slab_q &operator=(const slab_q &) = delete;
+
+    ~slab_q()
+    {
+        while (!empty())
+        {
+            drop_front_();
+        }
+    }
+
+    // push back, overrun (oldest) records until the new one fits
+    void push_back(T &&item)
+    {
+        const string_view_t payload = item.payload();
+        const bool inline_payload = payload.size() <= SPDLOG_ASYNC_SLAB_MAX_PAYLOAD;
+        const size_t size = record_size_(inline_payload ? payload.size() : sizeof(char *));
+        while (!fits_(size))
+        {
+            drop_front_();
+            ++overrun_counter_;
+        }
+
+        if (!wrapped_ && capacity_ - tail_ < size)
+        {
+            // no room left at the end of the arena - continue at its start
+            end_ = tail_;
+            tail_ = 0;
+            wrapped_ = true;
+        }
+
+        auto *rec = new (buf_.get() + tail_) record(std::move(item), size, payload.size());
+        if (inline_payload)
+        {
+            std::memcpy(payload_of_(rec), payload.data(), payload.size());
+        }
+        else
+        {
+            char *heap_payload = new char[payload.size()];
+            std::memcpy(heap_payload, payload.data(), payload.size());
+            std::memcpy(payload_of_(rec), &heap_payload, sizeof(heap_payload));
+        }
+        tail_ += size;
+        ++count_;
+    }
+
+    // Pop item from front.
+    // If there are no elements in the container, the behavior is undefined.
+    void pop_front(T &popped_item)
+    {
+        record *rec = front_();
+        static_cast<header_type &>(popped_item) = std::move(rec->header);
+        popped_item.raw.clear();
+        popped_item.borrowed_payload = string_view_t();
+        const char *payload = payload_of_(rec);
+        if (rec->payload_size > SPDLOG_ASYNC_SLAB_MAX_PAYLOAD)
+        {
+            std::memcpy(&payload, payload, sizeof(payload));
+        }
+        popped_item.raw.append(payload, payload + rec->payload_size);
+        drop_front_();
+    }
+
+    // header of the front record.
+    // If there are no elements in the container, the behavior is undefined.
+    const header_type &front()
+    {
+        return front_()->header;
+    }
+
+    bool empty()
+    {
+        return count_ == 0;
+    }
+
+    // true if a record of max payload size might not fit
+    bool full() const
+    {
+        return !fits_(record_size_(SPDLOG_ASYNC_SLAB_MAX_PAYLOAD));
+    }
+
+    size_t size() const
+    {
+        return count_;
+    }
+
+    // in records of 64 bytes payload
+    size_t capacity() const
+    {
+        return capacity_ / record_size_(64);
+    }
+
+    // reallocate the arena for max_items records of 64 bytes payload, keeping
+    // the records in order.
+    // never shrinks below the bytes used by the current records.
+    void resize(size_t max_items)
+    {
+        size_t used = 0;
+        for_each_record_([&](record *rec) { used += rec->size; });
+        const size_t new_capacity = (std::max)(arena_size_(max_items), used);
+        std::unique_ptr<char[]> new_buf(new char[new_capacity]);
+
+        // move the records to the start of the new arena
+        size_t offset = 0;
+        for_each_record_([&](record *rec) {
+            auto *moved = new (new_buf.get() + offset) record(std::move(rec->header), rec->size, rec->payload_size);
+            std::memcpy(payload_of_(moved), payload_of_(rec), rec->size - sizeof(record));
+            offset += rec->size;
+            rec->~record();
+        });
+
+        buf_.swap(new_buf);
+        capacity_ = new_capacity;
+        head_ = 0;
+        tail_ = offset;
+        end_ = 0;
+        wrapped_ = false;
+    }
+
+    size_t overrun_counter() const
+    {
+        return overrun_counter_;
+    }
+
+    // visit the items from the oldest as fn(header, payload), without moving them.
+    // for crash_handler only: the caller owns the queue or every other thread is stopped.
+    template<typename Fn>
+    void for_each_unsafe(Fn fn)
+    {
+        for_each_record_([&](record *rec) {
+            const char *payload = payload_of_(rec);
+            if (rec->payload_size > SPDLOG_ASYNC_SLAB_MAX_PAYLOAD)
+            {
+                std::memcpy(&payload, payload, sizeof(payload));
+            }
+            fn(rec->header, string_view_t(payload, rec->payload_size));
+        });
+    }
+
+private:
+    struct record
+    {
+        record(header_type &&h, size_t record_size, size_t the_payload_size)
+            : size(record_size)
+            , payload_size(the_payload_size)
+            , header(std::move(h))
+        {
+        }
+
+        size_t size;
+        size_t payload_size;
+        header_type header;
+    };
+
+    static size_t arena_size_(size_t max_items)
+    {
+        return (std::max)(max_items * record_size_(64), 2 * record_size_(SPDLOG_ASYNC_SLAB_MAX_PAYLOAD));
+    }
+
+    static size_t record_size_(size_t payload_size)
+    {
+        const size_t align = alignof(record);
+        return (sizeof(record) + payload_size + align - 1) / align * align;
+    }
+
+    static char *payload_of_(record *rec)
+    {
+        return reinterpret_cast<char *>(rec) + sizeof(record);
+    }
+
+    // used bytes are [head_, tail_), or [head_, end_) and [0, tail_) once wrapped.
+    bool fits_(size_t size) const
+    {
+        if (count_ == 0)
+        {
+            return true;
+        }
+        if (wrapped_)
+        {
+            return head_ - tail_ >= size;
+        }
+        return capacity_ - tail_ >= size || head_ >= size;
+    }
+
+    record *front_()
+    {
+        return reinterpret_cast<record *>(buf_.get() + head_);
+    }
+
+    // visit the records from the oldest. (the payload bytes - or heap address - follow each record)
+    template<typename Fn>
+    void for_each_record_(Fn fn)
+    {
+        if (count_ == 0)
+        {
+            return;
+        }
+        size_t pos = head_;
+        const size_t first_end = wrapped_ ? end_ : tail_;
+        while (pos < first_end)
+        {
+            auto *rec = reinterpret_cast<record *>(buf_.get() + pos);
+            pos += rec->size;
+            fn(rec);
+        }
+        if (wrapped_)
+        {
+            pos = 0;
+            while (pos < tail_)
+            {
+                auto *rec = reinterpret_cast<record *>(buf_.get() + pos);
+                pos += rec->size;
+                fn(rec);
+            }
+        }
+    }
+
+    // destroy the front record (releasing its barrier token and heap payload, if any)
+    void drop_front_()
+    {
+        record *rec = front_();
+        if (rec->payload_size > SPDLOG_ASYNC_SLAB_MAX_PAYLOAD)
+        {
+            char *heap_payload;
+            std::memcpy(&heap_payload, payload_of_(rec), sizeof(heap_payload));
+            delete[] heap_payload;
+        }
+        head_ += rec->size;
+        rec->~record();
+
+        if (--count_ == 0)
+        {
+            head_ = tail_ = 0;
+            wrapped_ = false;
+        }
+        else if (wrapped_ && head_ == end_)
+        {
+            head_ = 0;
+            wrapped_ = false;
+        }
+    }
+
+    size_t capacity_;
+    std::unique_ptr<char[]> buf_;
+
+    size_t head_ = 0;
+    size_t tail_ = 0;
+    size_t end_ = 0;
+    bool wrapped_ = false;
+    size_t count_ = 0;
+
+    size_t overrun_counter_ = 0;
+};
+} // namespace details
+} // namespace spdlog
@@ -0,0 +1,612 @@
+#pragma once
+
+//
+// Copyright(c) 2019 Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+// multi producer-single consumer queue made of per producer thread lanes.
+// Each producer thread lazily registers its own single producer-single consumer
+// ring buffer (found through thread local storage), so producers never
+// contend with each other - not even on a shared atomic tail.
+// The (single) consumer peeks the head of every lane and pops the oldest one,
+// so the output stays ordered by message time (ties broken by msg_id when
+// SPDLOG_ENABLE_MESSAGE_COUNTER is defined).
+// Fences (items for which item.is_fence() is true, e.g. drain()'s barriers) don't go
+// through the lanes: each records the tail of every lane when posted, and is popped
+// once the consumer passed all of them - whatever the clock says.
+//
+// enqueue(..) - will block until room found in the caller's lane (a fence never waits).
+// enqueue_nowait(..) - will return immediately. Since a producer cannot
+// reclaim a slot that the consumer may be reading, the new message is the one
+// discarded (and counted as overrun) if the caller's lane is full.
+// try_enqueue(..) - will return immediately with false if the caller's lane is
+// full.
+// dequeue_for(..) - will block until any lane is not empty or timeout have
+// passed.
+// try_dequeue_bulk(..) - will return immediately (for spinning consumers).
+// size(), blocked_time() - approximate number of items in all lanes, and the
+// total time producers waited in enqueue(..) for room.
+// for_each_unsafe(..) - visit the queued items lane by lane (crash_handler).
+//
+// Each lane holds min(max_items, SPDLOG_ASYNC_LANE_MAX_ITEMS) pre-constructed
+// items, allocated when its thread first logs to the queue.
+
+#include "spdlog/common.h"
+
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(SPDLOG_NO_TLS)
+#error "SPDLOG_ASYNC_SPSC_LANES requires thread local storage (SPDLOG_NO_TLS is defined)"
+#endif
+
+#ifndef SPDLOG_CACHE_LINE_SIZE
+#define SPDLOG_CACHE_LINE_SIZE 64
+#endif
+
+#ifndef SPDLOG_ASYNC_LANE_MAX_ITEMS
+#define SPDLOG_ASYNC_LANE_MAX_ITEMS 1024
+#endif
+
+namespace spdlog {
+namespace details {
+
+template<typename T>
+class spsc_lanes_queue
+{
+public:
+    using item_type = T;
+
+    // max_items is the capacity of each producer's lane (rounded up to the next power of 2),
+    // up to SPDLOG_ASYNC_LANE_MAX_ITEMS
+    explicit spsc_lanes_queue(size_t max_items)
+        : lane_capacity_((std::min)(max_items, static_cast<size_t>(SPDLOG_ASYNC_LANE_MAX_ITEMS)))
+        , id_(next_queue_id_())
+    {
+    }
+
+    spsc_lanes_queue(const spsc_lanes_queue &) = delete;
+    spsc_lanes_queue &operator=(const spsc_lanes_queue &) = delete;
+
+    ~spsc_lanes_queue()
+    {
+        std::lock_guard<std::mutex> lock(lanes_mutex_);
+        for (auto &l : lanes_)
+        {
+            l->closed.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    // try to enqueue and block if no room left in the caller's lane
+    void enqueue(T &&item)
+    {
+        if (item.is_fence())
+        {
+            post_fence_(std::move(item));
+            return;
+        }
+        auto &l = local_lane_();
+        if (!l.try_push(item))
+        {
+            wait_for_room_(l, item);
+        }
+        notify_consumer_();
+    }
+
+    // enqueue immediately. discard the new message if no room left in the caller's lane.
+    void enqueue_nowait(T &&item)
+    {
+        if (!try_enqueue(std::move(item)))
+        {
+            overrun_counter_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // enqueue immediately if there is room left in the caller's lane. return false otherwise.
+    bool try_enqueue(T &&item)
+    {
+        if (item.is_fence())
+        {
+            post_fence_(std::move(item));
+            return true;
+        }
+        if (!local_lane_().try_push(item))
+        {
+            return false;
+        }
+        notify_consumer_();
+        return true;
+    }
+
+    // try to dequeue item. if no item found. wait upto timeout and try again
+    // Return true, if succeeded dequeue item, false otherwise
+    // Must be called from one consumer thread only.
+    bool dequeue_for(T &popped_item, std::chrono::milliseconds wait_duration)
+    {
+        if (!pop_or_park_(popped_item, wait_duration))
+        {
+            return false;
+        }
+        notify_producers_();
+        return true;
+    }
+
+    // dequeue up to max_items. if no item found. wait upto timeout and try again
+    // stops right after an item for which stop_after(item) returns true.
+    // Return the number of dequeued items (0 if timeout passed)
+    // Must be called from one consumer thread only.
+    template<typename StopPred>
+    size_t dequeue_bulk_for(T *items, size_t max_items, std::chrono::milliseconds wait_duration, StopPred stop_after)
+    {
+        if (max_items == 0 || !pop_or_park_(items[0], wait_duration))
+        {
+            return 0;
+        }
+        size_t n = 1;
+        if (!stop_after(items[0]))
+        {
+            while (n < max_items && try_pop_(items[n]))
+            {
+                if (stop_after(items[n++]))
+                {
+                    break;
+                }
+            }
+        }
+        notify_producers_();
+        return n;
+    }
+
+    // dequeue up to max_items without waiting (for spinning consumers).
+    // Return the number of dequeued items
+    // Must be called from one consumer thread only.
+    template<typename StopPred>
+    size_t try_dequeue_bulk(T *items, size_t max_items, StopPred stop_after)
+    {
+        size_t n = 0;
+        while (n < max_items && try_pop_(items[n]))
+        {
+            if (stop_after(items[n++]))
+            {
+                break;
+            }
+        }
+        if (n > 0)
+        {
+            notify_producers_();
+        }
+        return n;
+    }
+
+    size_t overrun_counter()
+    {
+        return overrun_counter_.load(std::memory_order_relaxed);
+    }
+
+    size_t size()
+    {
+        size_t rv = fences_pending_.load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(lanes_mutex_);
+        for (auto &l : lanes_)
+        {
+            size_t h = l->head.load(std::memory_order_relaxed);
+            rv += l->tail.load(std::memory_order_relaxed) - h;
+        }
+        return rv;
+    }
+
+    // of each producer thread's lane
+    size_t capacity() const
+    {
+        return round_up_pow2_(lane_capacity_);
+    }
+
+    std::chrono::nanoseconds blocked_time()
+    {
+        return std::chrono::nanoseconds(blocked_ns_.load(std::memory_order_relaxed));
+    }
+
+    // visit the log items of each lane from the oldest as fn(header, payload).
+    // takes no lock, so it can be called from a signal handler - an item popped
+    // meanwhile may be torn. visits nothing if the list of lanes is being modified
+    // (a lane registered or released) at that moment.
+    template<typename Fn>
+    void for_each_unsafe(Fn fn)
+    {
+        lanes_readers_.fetch_add(1, std::memory_order_seq_cst);
+        if (!lanes_writer_.load(std::memory_order_seq_cst))
+        {
+            for (auto &l : lanes_)
+            {
+                const size_t t = l->tail.load(std::memory_order_acquire);
+                for (size_t h = l->head.load(std::memory_order_acquire); h != t; h++)
+                {
+                    const T &item = l->items[h & l->mask];
+                    fn(item, item.payload());
+                }
+            }
+        }
+        lanes_readers_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+private:
+    struct lane
+    {
+        explicit lane(size_t max_items)
+            : mask(round_up_pow2_(max_items) - 1)
+            , items(mask + 1)
+        {
+        }
+
+        // producer side
+        bool try_push(T &item)
+        {
+            size_t t = tail.load(std::memory_order_relaxed);
+            if (t - cached_head > mask)
+            {
+                cached_head = head.load(std::memory_order_acquire);
+                if (t - cached_head > mask)
+                {
+                    return false; // full
+                }
+            }
+            items[t & mask] = std::move(item);
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        // consumer side
+        T *front()
+        {
+            size_t h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire))
+            {
+                return nullptr;
+            }
+            return &items[h & mask];
+        }
+
+        void pop_front(T &popped_item)
+        {
+            size_t h = head.load(std::memory_order_relaxed);
+            popped_item = std::move(items[h & mask]);
+            head.store(h + 1, std::memory_order_release);
+        }
+
+        const size_t mask;
+        std::vector<T> items;
+        std::atomic<bool> detached{false}; // owning thread exited
+        std::atomic<bool> closed{false};   // queue destroyed
+
+        char pad0_[SPDLOG_CACHE_LINE_SIZE];
+        std::atomic<size_t> head{0};
+        char pad1_[SPDLOG_CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+        std::atomic<size_t> tail{0};
+        size_t cached_head = 0;
+        char pad2_[SPDLOG_CACHE_LINE_SIZE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+    };
+
+    using lane_ptr = std::shared_ptr<lane>;
+
+    // a fence, and the tail of each lane when it was posted
+    struct fence
+    {
+        T item;
+        std::vector<std::pair<lane_ptr, size_t>> tails;
+    };
+
+    // modification of lanes_ (lanes_mutex_ must be held): waits for for_each_unsafe()
+    // to finish, and makes the next ones skip the lanes until done
+    class lanes_write_guard
+    {
+    public:
+        explicit lanes_write_guard(spsc_lanes_queue &q)
+            : q_(q)
+        {
+            q_.lanes_writer_.store(true, std::memory_order_seq_cst);
+            while (q_.lanes_readers_.load(std::memory_order_seq_cst) != 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        ~lanes_write_guard()
+        {
+            q_.lanes_writer_.store(false, std::memory_order_seq_cst);
+        }
+
+        lanes_write_guard(const lanes_write_guard &) = delete;
+        lanes_write_guard &operator=(const lanes_write_guard &) = delete;
+
+    private:
+        spsc_lanes_queue &q_;
+    };
+
+    // the calling thread's lanes, one per queue it has logged to.
+    // marks them detached on thread exit so the consumer can drop them once drained.
+    struct thread_lanes
+    {
+        std::vector<std::pair<size_t, lane_ptr>> lanes;
+
+        ~thread_lanes()
+        {
+            for (auto &l : lanes)
+            {
+                l.second->detached.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    static size_t round_up_pow2_(size_t n)
+    {
+        size_t rv = 2;
+        while (rv < n)
+        {
+            rv <<= 1;
+        }
+        return rv;
+    }
+
+    // queue ids are never reused, unlike addresses, so stale thread local
+    // entries of destroyed queues can't be mistaken for live ones.
+    static size_t next_queue_id_()
+    {
+        static std::atomic<size_t> id{0};
+        return ++id;
+    }
+
+    lane &local_lane_()
+    {
+        static thread_local thread_lanes tls;
+        for (auto &l : tls.lanes)
+        {
+            if (l.first == id_)
+            {
+                return *l.second;
+            }
+        }
+
+        // first message from this thread: prune lanes of destroyed queues and register a new lane
+        auto &v = tls.lanes;
+        for (auto it = v.begin(); it != v.end();)
+        {
+            it = it->second->closed.load(std::memory_order_relaxed) ? v.erase(it) : it + 1;
+        }
+        auto new_lane = std::make_shared<lane>(lane_capacity_);
+        {
+            std::lock_guard<std::mutex> lock(lanes_mutex_);
+            lanes_write_guard guard(*this);
+            lanes_.push_back(new_lane);
+            lanes_version_.fetch_add(1, std::memory_order_release);
+        }
+        v.emplace_back(id_, new_lane);
+        return *new_lane;
+    }
+
+    // consumer side: refresh the private snapshot of the lanes if any lane was
+    // registered since, and forget lanes of exited threads once they are drained.
+    void refresh_lanes_()
+    {
+        size_t version = lanes_version_.load(std::memory_order_acquire);
+        if (version != consumer_version_)
+        {
+            std::lock_guard<std::mutex> lock(lanes_mutex_);
+            consumer_lanes_ = lanes_;
+            consumer_version_ = lanes_version_.load(std::memory_order_relaxed);
+        }
+
+        for (auto &l : consumer_lanes_)
+        {
+            if (l->detached.load(std::memory_order_acquire) && l->front() == nullptr)
+            {
+                std::lock_guard<std::mutex> lock(lanes_mutex_);
+                {
+                    lanes_write_guard guard(*this);
+                    for (auto it = lanes_.begin(); it != lanes_.end(); ++it)
+                    {
+                        if (*it == l)
+                        {
+                            lanes_.erase(it);
+                            break;
+                        }
+                    }
+                }
+                consumer_lanes_ = lanes_;
+                consumer_version_ = lanes_version_.fetch_add(1, std::memory_order_relaxed) + 1;
+                break; // at most one per call, the rest is collected on the next calls
+            }
+        }
+    }
+
+    static bool older_(const T &lhs, const T &rhs)
+    {
+#if defined(SPDLOG_ENABLE_MESSAGE_COUNTER)
+        if (lhs.time == rhs.time)
+        {
+            return lhs.msg_id < rhs.msg_id;
+        }
+#endif
+        return lhs.time < rhs.time;
+    }
+
+    // pop the oldest head among all lanes - or the next fence, once every item posted before it was popped
+    bool try_pop_(T &popped_item)
+    {
+        refresh_lanes_();
+        if (fences_pending_.load(std::memory_order_acquire) != 0)
+        {
+            std::lock_guard<std::mutex> lock(fences_mutex_);
+            if (!fences_.empty())
+            {
+                pop_fenced_(popped_item);
+                return true;
+            }
+        }
+        lane *oldest = nullptr;
+        T *oldest_item = nullptr;
+        for (auto &l : consumer_lanes_)
+        {
+            T *item = l->front();
+            if (item != nullptr && (oldest_item == nullptr || older_(*item, *oldest_item)))
+            {
+                oldest = l.get();
+                oldest_item = item;
+            }
+        }
+        if (oldest == nullptr)
+        {
+            return false;
+        }
+        oldest->pop_front(popped_item);
+        return true;
+    }
+
+    // pop the oldest head among the lanes the next fence waits for, or the fence itself
+    // if it waits for none (fences_mutex_ must be held)
+    void pop_fenced_(T &popped_item)
+    {
+        auto &next = fences_.front();
+        lane *oldest = nullptr;
+        T *oldest_item = nullptr;
+        for (auto &l : next.tails)
+        {
+            if (l.first->head.load(std::memory_order_relaxed) >= l.second)
+            {
+                continue;
+            }
+            T *item = l.first->front();
+            if (oldest_item == nullptr || older_(*item, *oldest_item))
+            {
+                oldest = l.first.get();
+                oldest_item = item;
+            }
+        }
+        if (oldest != nullptr)
+        {
+            oldest->pop_front(popped_item);
+            return;
+        }
+        popped_item = std::move(next.item);
+        fences_.pop_front();
+        fences_pending_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // queue the fence after the current tail of every lane
+    void post_fence_(T &&item)
+    {
+        fence f{std::move(item), {}};
+        {
+            std::lock_guard<std::mutex> lock(lanes_mutex_);
+            f.tails.reserve(lanes_.size());
+            for (auto &l : lanes_)
+            {
+                f.tails.emplace_back(l, l->tail.load(std::memory_order_acquire));
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(fences_mutex_);
+            fences_.push_back(std::move(f));
+            fences_pending_.fetch_add(1, std::memory_order_release);
+        }
+        notify_consumer_();
+    }
+
+    // pop an item, or park until one is pushed or timeout have passed
+    bool pop_or_park_(T &popped_item, std::chrono::milliseconds wait_duration)
+    {
+        if (try_pop_(popped_item))
+        {
+            return true;
+        }
+        std::unique_lock<std::mutex> lock(park_mutex_);
+        consumer_waiting_.store(true, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool popped = push_cv_.wait_for(lock, wait_duration, [&] { return this->try_pop_(popped_item); });
+        consumer_waiting_.store(false, std::memory_order_relaxed);
+        return popped;
+    }
+
+    // slow path of enqueue(): spin shortly, then park until the consumer frees a slot.
+    void wait_for_room_(lane &l, T &item)
+    {
+        auto wait_start = std::chrono::steady_clock::now();
+        bool pushed = false;
+        for (int i = 0; i < 64 && !pushed; i++)
+        {
+            std::this_thread::yield();
+            pushed = l.try_push(item);
+        }
+        if (!pushed)
+        {
+            std::unique_lock<std::mutex> lock(park_mutex_);
+            producers_waiting_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            pop_cv_.wait(lock, [&] { return l.try_push(item); });
+            producers_waiting_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - wait_start);
+        blocked_ns_.fetch_add(static_cast<uint64_t>(waited.count()), std::memory_order_relaxed);
+    }
+
+    void notify_consumer_()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (consumer_waiting_.load(std::memory_order_relaxed))
+        {
+            {
+                std::lock_guard<std::mutex> lock(park_mutex_);
+            }
+            push_cv_.notify_one();
+        }
+    }
+
+    // parked producers wait on different lanes, so wake them all
+    void notify_producers_()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (producers_waiting_.load(std::memory_order_relaxed) > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(park_mutex_);
+            }
+            pop_cv_.notify_all();
+        }
+    }
+
+    const size_t lane_capacity_;
+    const size_t id_;
+
+    std::mutex lanes_mutex_;
+    std::vector<lane_ptr> lanes_;
+    std::atomic<size_t> lanes_version_{0};
+    std::atomic<bool> lanes_writer_{false};
+    std::atomic<int> lanes_readers_{0};
+
+    std::mutex fences_mutex_;
+    std::deque<fence> fences_;
+    std::atomic<size_t> fences_pending_{0};
+
+    // owned by the consumer thread
+    std::vector<lane_ptr> consumer_lanes_;
+    size_t consumer_version_ = 0;
+
+    std::atomic<bool> consumer_waiting_{false};
+    std::atomic<size_t> producers_waiting_{0};
+    std::atomic<size_t> overrun_counter_{0};
+    std::atomic<uint64_t> blocked_ns_{0};
+    std::mutex park_mutex_;
+    std::condition_variable push_cv_;
+    std::condition_variable pop_cv_;
+};
+} // namespace details
+} // namespace spdlog
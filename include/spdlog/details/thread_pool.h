@@ -1,40 +1,373 @@
 #pragma once
 
+#include "spdlog/details/deferred_args.h"
+#include "spdlog/details/file_helper.h"
 #include "spdlog/details/fmt_helper.h"
 #include "spdlog/details/log_msg.h"
+
+#if defined(SPDLOG_ASYNC_LOCKFREE_QUEUE) && defined(SPDLOG_ASYNC_SPSC_LANES)
+#error "SPDLOG_ASYNC_LOCKFREE_QUEUE and SPDLOG_ASYNC_SPSC_LANES are mutually exclusive"
+#endif
+
+#if defined(SPDLOG_ASYNC_SLAB_QUEUE) && (defined(SPDLOG_ASYNC_LOCKFREE_QUEUE) || defined(SPDLOG_ASYNC_SPSC_LANES))
+#error "SPDLOG_ASYNC_SLAB_QUEUE applies to the default (mutex protected) queue only"
+#endif
+
+#if defined(SPDLOG_ASYNC_PRIORITY_QUEUE) && (defined(SPDLOG_ASYNC_LOCKFREE_QUEUE) || defined(SPDLOG_ASYNC_SPSC_LANES))
+#error "SPDLOG_ASYNC_PRIORITY_QUEUE applies to the default (mutex protected) queue only"
+#endif
+
+#if defined(SPDLOG_ASYNC_LOCKFREE_QUEUE)
+#include "spdlog/details/mpmc_lockfree_q.h"
+#elif defined(SPDLOG_ASYNC_SPSC_LANES)
+#include "spdlog/details/spsc_lanes_q.h"
+#else
 #include "spdlog/details/mpmc_blocking_q.h"
+#if defined(SPDLOG_ASYNC_SLAB_QUEUE)
+#include "spdlog/details/slab_q.h"
+#endif
+#if defined(SPDLOG_ASYNC_PRIORITY_QUEUE)
+#include "spdlog/details/priority_q.h"
+#endif
+#endif
 #include "spdlog/details/os.h"
+#if defined(SPDLOG_ASYNC_CRASH_DUMP)
+#include "spdlog/details/crash_handler.h"
+#endif
+#if defined(SPDLOG_ASYNC_SHM_JOURNAL)
+#include "spdlog/details/shm_journal.h"
+#endif
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 
 namespace spdlog {
 namespace details {
 
-using async_logger_ptr = std::shared_ptr<spdlog::async_logger>;
+// raw pointer: the logger outlives its queued messages since ~async_logger()
+// waits for them (see thread_pool::drain_logger()).
+using async_logger_ptr = spdlog::async_logger *;
+
+#ifndef SPDLOG_ASYNC_BATCH_SIZE
+#define SPDLOG_ASYNC_BATCH_SIZE 64
+#endif
+
+// max number of messages a worker thread dequeues at once
+static const size_t async_batch_size = SPDLOG_ASYNC_BATCH_SIZE;
+
+#ifndef SPDLOG_CACHE_LINE_SIZE
+#define SPDLOG_CACHE_LINE_SIZE 64
+#endif
+
+// number of buckets in thread_pool_stats::latency_histogram
+static const size_t async_latency_buckets = 24;
+
+// snapshot of a thread pool's counters (see thread_pool::stats()).
+// the counters are read one by one while the pool is running, so they are
+// only roughly consistent with each other.
+struct thread_pool_stats
+{
+    // total capacity of the queue(s)
+    size_t queue_capacity = 0;
+    // msgs currently in the queue(s)
+    size_t queue_depth = 0;
+    // deepest queue seen by a worker thread right after dequeuing a batch
+    size_t queue_depth_high_watermark = 0;
+    // msgs accepted by the queue(s) - including the overrun ones
+    uint64_t enqueued = 0;
+    uint64_t dequeued = 0;
+    // log msgs written to the sinks
+    uint64_t written = 0;
+    // msgs dropped by async_overflow_policy::overrun_oldest
+    uint64_t overrun = 0;
+    // total time producers were blocked in enqueue (async_overflow_policy::block)
+    std::chrono::nanoseconds producers_blocked_time{0};
+    // time from the log call (msg.time) until the msg's batch was written to the sinks:
+    // latency_histogram[0] counts the log msgs that took less than 1us,
+    // latency_histogram[i] the ones that took [2^(i-1), 2^i) microseconds, and the
+    // last bucket all the slower ones.
+    std::array<uint64_t, async_latency_buckets> latency_histogram{};
+};
+
+// result of thread_pool::shutdown()
+struct thread_pool_shutdown_stats
+{
+    // log msgs written to the sinks during the shutdown
+    uint64_t flushed = 0;
+    // log msgs never written to the sinks (spilled ones included)
+    uint64_t abandoned = 0;
+    // abandoned log msgs appended to the spill file
+    uint64_t spilled = 0;
+    // the deadline passed before the backlog was processed
+    bool timed_out = false;
+};
+
+// counters of one worker thread.
+// written by their worker thread only (no read-modify-write, so no contended
+// cache lines), and read from any thread by thread_pool::stats().
+struct async_worker_stats
+{
+    async_worker_stats()
+    {
+        for (auto &bucket : latency_histogram)
+        {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    template<typename T>
+    static void add(std::atomic<T> &counter, T n)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> dequeued{0};
+    std::atomic<uint64_t> written{0};
+    std::atomic<size_t> depth_high_watermark{0};
+    std::array<std::atomic<uint64_t>, async_latency_buckets> latency_histogram;
+    char pad_[SPDLOG_CACHE_LINE_SIZE]; // keep other allocations off the last cache line
+};
 
 enum class async_msg_type
 {
     log,
     flush,
-    terminate
+    barrier,
+    terminate,
+    discarded // a log msg dropped by its worker thread (e.g. its deferred formatting failed)
 };
 
-// Async msg to move to/from the queue
+// Rendezvous of the worker threads, posted through the queue as one barrier
+// msg per worker thread (see thread_pool::drain()).
+// A worker reaching its barrier msg waits for the others, so no worker can
+// consume two of them. Once all arrived, every msg posted before was processed.
+// The last worker to arrive runs on_completion (e.g. flushes a logger, see
+// thread_pool::post_flush_barrier()) and fulfills the barrier's future - unless
+// some barrier msg was discarded, which breaks the future with spdlog_ex instead.
+class async_barrier
+{
+public:
+    explicit async_barrier(size_t parties, std::function<void()> on_completion = nullptr)
+        : pending_(parties)
+        , on_completion_(std::move(on_completion))
+    {
+    }
+
+    async_barrier(const async_barrier &) = delete;
+    async_barrier &operator=(const async_barrier &) = delete;
+
+    // called by a worker thread upon its barrier msg
+    void arrive_and_wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (--pending_ == 0)
+        {
+            complete_();
+            return;
+        }
+        cv_.wait(lock, [this] { return this->pending_ == 0; });
+    }
+
+    // called when a barrier msg is discarded without being processed
+    void discard()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        discarded_ = true;
+        if (--pending_ == 0)
+        {
+            complete_();
+        }
+    }
+
+    std::future<void> get_future()
+    {
+        return completed_.get_future();
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return this->pending_ == 0; });
+    }
+
+private:
+    void complete_()
+    {
+        if (discarded_)
+        {
+            completed_.set_exception(std::make_exception_ptr(spdlog_ex("async barrier msg was discarded (queue overrun)")));
+        }
+        else
+        {
+            try
+            {
+                if (on_completion_)
+                {
+                    on_completion_();
+                }
+                completed_.set_value();
+            }
+            catch (...)
+            {
+                completed_.set_exception(std::current_exception());
+            }
+        }
+        cv_.notify_all();
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    size_t pending_;
+    bool discarded_ = false;
+    std::function<void()> on_completion_;
+    std::promise<void> completed_;
+};
+
+// Handle to the barrier carried by a barrier msg.
+// Arrives at the barrier if the msg is destroyed or overwritten without being
+// processed (e.g. overrun in the queue), so the waiter is never left hanging.
+class async_barrier_token
+{
+public:
+    async_barrier_token() = default;
+
+    explicit async_barrier_token(std::shared_ptr<async_barrier> barrier)
+        : barrier_(std::move(barrier))
+    {
+    }
+
+    async_barrier_token(const async_barrier_token &) = delete;
+    async_barrier_token &operator=(const async_barrier_token &) = delete;
+
+    async_barrier_token(async_barrier_token &&other) SPDLOG_NOEXCEPT : barrier_(std::move(other.barrier_)) {}
+
+    async_barrier_token &operator=(async_barrier_token &&other) SPDLOG_NOEXCEPT
+    {
+        if (this != &other)
+        {
+            release_();
+            barrier_ = std::move(other.barrier_);
+        }
+        return *this;
+    }
+
+    ~async_barrier_token()
+    {
+        release_();
+    }
+
+    explicit operator bool() const
+    {
+        return barrier_ != nullptr;
+    }
+
+    void arrive_and_wait()
+    {
+        auto barrier = std::move(barrier_);
+        barrier->arrive_and_wait();
+    }
+
+private:
+    void release_()
+    {
+        if (barrier_)
+        {
+            barrier_->discard();
+            barrier_.reset();
+        }
+    }
+
+    std::shared_ptr<async_barrier> barrier_;
+};
+
+// Everything but the payload of an async msg.
 // Movable only. should never be copied
-struct async_msg
+struct async_msg_header
 {
     async_msg_type msg_type;
     level::level_enum level;
     log_clock::time_point time;
     size_t thread_id;
-    fmt::basic_memory_buffer<char, 176> raw;
-
     size_t msg_id;
     source_loc source;
-    async_logger_ptr worker_ptr;
+    async_logger_ptr worker_ptr{nullptr};
+    async_barrier_token barrier;
+    // set if the payload is a packed log call to be formatted by the worker thread
+    deferred_format_fn format_fn{nullptr};
+    // order of the msg in its queue (set by priority_q)
+    size_t queue_seq{0};
+#if defined(SPDLOG_ASYNC_SHM_JOURNAL)
+    // record of the msg in the shm_journal (if journaled)
+    shm_journal_record journal;
+#endif
+
+    async_msg_header() = default;
+    async_msg_header(const async_msg_header &) = delete;
+
+// support for vs2013 move
+#if defined(_MSC_VER) && _MSC_VER <= 1800
+    async_msg_header(async_msg_header &&other) SPDLOG_NOEXCEPT : msg_type(other.msg_type),
+                                                                 level(other.level),
+                                                                 time(other.time),
+                                                                 thread_id(other.thread_id),
+                                                                 msg_id(other.msg_id),
+                                                                 source(other.source),
+                                                                 worker_ptr(other.worker_ptr),
+                                                                 barrier(std::move(other.barrier)),
+                                                                 format_fn(other.format_fn),
+                                                                 queue_seq(other.queue_seq)
+#if defined(SPDLOG_ASYNC_SHM_JOURNAL)
+                                                                 ,
+                                                                 journal(std::move(other.journal))
+#endif
+    {
+    }
+
+    async_msg_header &operator=(async_msg_header &&other) SPDLOG_NOEXCEPT
+    {
+        msg_type = other.msg_type;
+        level = other.level;
+        time = other.time;
+        thread_id = other.thread_id;
+        msg_id = other.msg_id;
+        source = other.source;
+        worker_ptr = other.worker_ptr;
+        barrier = std::move(other.barrier);
+        format_fn = other.format_fn;
+        queue_seq = other.queue_seq;
+#if defined(SPDLOG_ASYNC_SHM_JOURNAL)
+        journal = std::move(other.journal);
+#endif
+        return *this;
+    }
+#else // (_MSC_VER) && _MSC_VER <= 1800
+    async_msg_header(async_msg_header &&) = default;
+    async_msg_header &operator=(async_msg_header &&) = default;
+#endif
+};
+
+// Async msg to move to/from the queue
+// Movable only. should never be copied
+struct async_msg : async_msg_header
+{
+    using header_type = async_msg_header;
+    static const size_t priority_lanes = 4;
+
+    fmt::basic_memory_buffer<char, 176> raw;
+    // set instead of raw when the payload is copied straight from the caller's
+    // log_msg into the queue storage during enqueue (SPDLOG_ASYNC_SLAB_QUEUE).
+    string_view_t borrowed_payload;
 
     async_msg() = default;
     ~async_msg() = default;
@@ -44,27 +377,17 @@ struct async_msg
 
 // support for vs2013 move
 #if defined(_MSC_VER) && _MSC_VER <= 1800
-    async_msg(async_msg &&other) SPDLOG_NOEXCEPT : msg_type(other.msg_type),
-                                                   level(other.level),
-                                                   time(other.time),
-                                                   thread_id(other.thread_id),
+    async_msg(async_msg &&other) SPDLOG_NOEXCEPT : async_msg_header(std::move(other)),
                                                    raw(move(other.raw)),
-                                                   msg_id(other.msg_id),
-                                                   source(other.source),
-                                                   worker_ptr(std::move(other.worker_ptr))
+                                                   borrowed_payload(other.borrowed_payload)
     {
     }
 
     async_msg &operator=(async_msg &&other) SPDLOG_NOEXCEPT
     {
-        msg_type = other.msg_type;
-        level = other.level;
-        time = other.time;
-        thread_id = other.thread_id;
+        async_msg_header::operator=(std::move(other));
         raw = std::move(other.raw);
-        msg_id = other.msg_id;
-        source = other.source;
-        worker_ptr = std::move(other.worker_ptr);
+        borrowed_payload = other.borrowed_payload;
         return *this;
     }
 #else // (_MSC_VER) && _MSC_VER <= 1800
@@ -73,27 +396,41 @@ struct async_msg
 #endif
 
     // construct from log_msg with given type
-    async_msg(async_logger_ptr &&worker, async_msg_type the_type, details::log_msg &m)
-        : msg_type(the_type)
-        , level(m.level)
-        , time(m.time)
-        , thread_id(m.thread_id)
-        , msg_id(m.msg_id)
-        , source(m.source)
-        , worker_ptr(std::move(worker))
+    async_msg(async_logger_ptr worker, async_msg_type the_type, details::log_msg &m)
     {
+        msg_type = the_type;
+        level = m.level;
+        time = m.time;
+        thread_id = m.thread_id;
+        msg_id = m.msg_id;
+        source = m.source;
+        worker_ptr = worker;
+#if defined(SPDLOG_ASYNC_SLAB_QUEUE)
+        borrowed_payload = m.payload;
+#else
         fmt_helper::append_string_view(m.payload, raw);
+#endif
+    }
+
+    async_msg(async_logger_ptr worker, async_msg_type the_type)
+    {
+        msg_type = the_type;
+        level = level::off;
+        thread_id = 0;
+        msg_id = 0;
+        worker_ptr = worker;
     }
 
-    async_msg(async_logger_ptr &&worker, async_msg_type the_type)
-        : msg_type(the_type)
-        , level(level::off)
-        , time()
-        , thread_id(0)
-        , msg_id(0)
-        , source()
-        , worker_ptr(std::move(worker))
+    // the payload, wherever it currently lives
+    string_view_t payload() const
     {
+        return borrowed_payload.size() > 0 ? borrowed_payload : string_view_t(raw.data(), raw.size());
+    }
+
+    explicit async_msg(std::shared_ptr<async_barrier> the_barrier)
+        : async_msg(nullptr, async_msg_type::barrier)
+    {
+        barrier = async_barrier_token(std::move(the_barrier));
     }
 
     explicit async_msg(async_msg_type the_type)
@@ -101,10 +438,40 @@ struct async_msg
     {
     }
 
+    // the msg must not be processed before any msg posted ahead of it, by any thread
+    // (see spsc_lanes_queue): a barrier waiter may destroy the loggers right after it.
+    bool is_fence() const
+    {
+        return static_cast<bool>(barrier) || msg_type == async_msg_type::terminate;
+    }
+
+    // lane of the msg with SPDLOG_ASYNC_PRIORITY_QUEUE: err and critical first, then info
+    // and warn, then trace and debug.
+    // control msgs go to the ordered lane 0 - e.g. a barrier must not be processed (or
+    // overrun) before the msgs posted ahead of it, or drain() could return too early.
+    size_t priority_lane() const
+    {
+        if (msg_type != async_msg_type::log)
+        {
+            return 0;
+        }
+        if (level < level::info)
+        {
+            return 1;
+        }
+        return level < level::err ? 2 : 3;
+    }
+
     // copy into log_msg
     log_msg to_log_msg()
     {
-        log_msg msg(&worker_ptr->name(), level, string_view_t(raw.data(), raw.size()));
+        return to_log_msg(string_view_t(raw.data(), raw.size()));
+    }
+
+    // copy into log_msg with the given (e.g. formatted by the worker) payload
+    log_msg to_log_msg(string_view_t formatted)
+    {
+        log_msg msg(&worker_ptr->name(), level, formatted);
         msg.time = time;
         msg.thread_id = thread_id;
         msg.msg_id = msg_id;
@@ -115,14 +482,43 @@ struct async_msg
     }
 };
 
+// the batch a worker thread is processing, published for the crash dump
+// (thread_pool_options::crash_dump): msgs[next, end) are not written to the sinks yet.
+struct async_worker_batch
+{
+    std::atomic<const async_msg *> msgs{nullptr};
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> end{0};
+};
+
 class thread_pool
 {
 public:
     using item_type = async_msg;
+#if defined(SPDLOG_ASYNC_LOCKFREE_QUEUE)
+    using q_type = details::mpmc_lockfree_queue<item_type>;
+#elif defined(SPDLOG_ASYNC_SPSC_LANES)
+    using q_type = details::spsc_lanes_queue<item_type>;
+#elif defined(SPDLOG_ASYNC_SLAB_QUEUE) && defined(SPDLOG_ASYNC_PRIORITY_QUEUE)
+    using q_type = details::mpmc_blocking_queue<item_type, details::priority_q<item_type, details::slab_q<item_type>>>;
+#elif defined(SPDLOG_ASYNC_SLAB_QUEUE)
+    using q_type = details::mpmc_blocking_queue<item_type, details::slab_q<item_type>>;
+#elif defined(SPDLOG_ASYNC_PRIORITY_QUEUE)
+    using q_type = details::mpmc_blocking_queue<item_type, details::priority_q<item_type>>;
+#else
     using q_type = details::mpmc_blocking_queue<item_type>;
+#endif
 
-    thread_pool(size_t q_max_items, size_t threads_n)
-        : q_(q_max_items)
+    // spin_budget - how long a worker polls the queue before sleeping (async_wait_strategy::spin_then_park)
+    thread_pool(size_t q_max_items, size_t threads_n, async_wait_strategy wait_strategy = async_wait_strategy::block,
+        std::chrono::microseconds spin_budget = std::chrono::microseconds(50))
+        : thread_pool(q_max_items, threads_n, make_options_(wait_strategy, spin_budget))
+    {
+    }
+
+    // with options.sharded, each worker thread gets its own queue of q_max_items
+    thread_pool(size_t q_max_items, size_t threads_n, thread_pool_options options)
+        : options_(std::move(options))
     {
         // std::cout << "thread_pool()  q_size_bytes: " << q_size_bytes <<
         // "\tthreads_n: " << threads_n << std::endl;
@@ -131,106 +527,1046 @@ public:
             throw spdlog_ex("spdlog::thread_pool(): invalid threads_n param (valid "
                             "range is 1-1000)");
         }
+#if defined(SPDLOG_ASYNC_SPSC_LANES)
+        if (threads_n != 1 && !options_.sharded)
+        {
+            throw spdlog_ex("spdlog::thread_pool(): per thread lanes (SPDLOG_ASYNC_SPSC_LANES) support a single worker thread per queue only");
+        }
+        if (options_.auto_grow_max_items > 0)
+        {
+            throw spdlog_ex("spdlog::thread_pool(): the queue can't grow with SPDLOG_ASYNC_SPSC_LANES (auto_grow_max_items)");
+        }
+#elif defined(SPDLOG_ASYNC_LOCKFREE_QUEUE)
+        if (options_.auto_grow_max_items > 0)
+        {
+            throw spdlog_ex("spdlog::thread_pool(): the queue can't grow with SPDLOG_ASYNC_LOCKFREE_QUEUE (auto_grow_max_items)");
+        }
+#endif
+        const size_t queues_n = options_.sharded ? threads_n : 1;
+        for (size_t i = 0; i < queues_n; i++)
+        {
+            queues_.push_back(details::make_unique<q_type>(q_max_items));
+        }
+        ordered_ = options_.parallel_formatting && queues_n == 1 && threads_n > 1;
+        if (!options_.shm_journal.empty())
+        {
+#if defined(SPDLOG_ASYNC_SHM_JOURNAL)
+            const size_t records = options_.shm_journal_records > 0 ? options_.shm_journal_records
+                                                                    : queues_n * q_max_items + threads_n * async_batch_size;
+            journal_ = details::make_unique<shm_journal>(options_.shm_journal, records);
+#else
+            throw spdlog_ex("spdlog::thread_pool(): shm_journal requires SPDLOG_ASYNC_SHM_JOURNAL");
+#endif
+        }
+        for (size_t i = 0; i < threads_n; i++)
+        {
+            worker_stats_.push_back(details::make_unique<async_worker_stats>());
+            worker_batches_.push_back(details::make_unique<async_worker_batch>());
+        }
+
+        // wait for the workers to apply their settings
+        auto started = std::make_shared<async_barrier>(threads_n + 1);
+        running_workers_ = threads_n;
         for (size_t i = 0; i < threads_n; i++)
         {
-            threads_.emplace_back(&thread_pool::worker_loop_, this);
+            threads_.emplace_back(&thread_pool::worker_loop_, this, i, started);
+            worker_ids_.push_back(threads_.back().get_id());
+        }
+        started->arrive_and_wait();
+        if (!start_error_.empty())
+        {
+            abort_start_(start_error_);
+        }
+#if defined(SPDLOG_ASYNC_CRASH_DUMP)
+        if (options_.crash_dump && !crash_handler::add(this, crash_dump_))
+        {
+            abort_start_("crash_dump is not supported on this platform, or too many thread pools use it");
+        }
+#else
+        if (options_.crash_dump)
+        {
+            abort_start_("crash_dump requires SPDLOG_ASYNC_CRASH_DUMP");
         }
+#endif
     }
 
     // message all threads to terminate gracefully join them
     ~thread_pool()
     {
+#if defined(SPDLOG_ASYNC_CRASH_DUMP)
+        crash_handler::remove(this);
+#endif
         try
         {
-            for (size_t i = 0; i < threads_.size(); i++)
-            {
-                post_async_msg_(async_msg(async_msg_type::terminate), async_overflow_policy::block);
-            }
-
-            for (auto &t : threads_)
-            {
-                t.join();
-            }
+            stop_workers_();
         }
         catch (...)
         {
         }
+#if defined(SPDLOG_ASYNC_SHM_JOURNAL)
+        if (journal_)
+        {
+            journal_->remove(); // all written (or abandoned by shutdown()) - nothing to recover
+        }
+#endif
     }
 
     thread_pool(const thread_pool &) = delete;
     thread_pool &operator=(thread_pool &&) = delete;
 
-    void post_log(async_logger_ptr &&worker_ptr, details::log_msg &msg, async_overflow_policy overflow_policy)
+    // format_fn is set if msg's payload is a packed log call (SPDLOG_ASYNC_DEFERRED_FORMATTING)
+    // return false if the msg was discarded (async_overflow_policy::discard_new, or after shutdown())
+    bool post_log(
+        async_logger_ptr worker_ptr, details::log_msg &msg, async_overflow_policy overflow_policy, deferred_format_fn format_fn = nullptr)
     {
-        async_msg async_m(std::move(worker_ptr), async_msg_type::log, msg);
-        post_async_msg_(std::move(async_m), overflow_policy);
+        if (stopped_.load(std::memory_order_relaxed))
+        {
+            return false;
+        }
+        async_msg async_m(worker_ptr, async_msg_type::log, msg);
+        async_m.format_fn = format_fn;
+#if defined(SPDLOG_ASYNC_SHM_JOURNAL)
+        if (journal_)
+        {
+            // consumed by async_m's destructor if the queue doesn't take it
+            async_m.journal = shm_journal_record(journal_.get(), journal_msg_(worker_ptr, msg, format_fn));
+        }
+#endif
+        return post_async_msg_(queue_of_logger_(worker_ptr), std::move(async_m), overflow_policy);
     }
 
-    void post_flush(async_logger_ptr &&worker_ptr, async_overflow_policy overflow_policy)
+    void post_flush(async_logger_ptr worker_ptr, async_overflow_policy overflow_policy)
     {
-        post_async_msg_(async_msg(std::move(worker_ptr), async_msg_type::flush), overflow_policy);
+        if (stopped_.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        post_async_msg_(queue_of_logger_(worker_ptr), async_msg(worker_ptr, async_msg_type::flush), overflow_policy);
     }
 
-    size_t overrun_counter()
+    // true if called from one of the worker threads, while they run (not after shutdown())
+    bool is_running_worker_thread() const
     {
-        return q_.overrun_counter();
+        return !stopped_.load(std::memory_order_relaxed) && is_worker_thread_();
     }
 
-private:
-    q_type q_;
-
-    std::vector<std::thread> threads_;
+    // block until every msg posted before this call was processed by the worker threads
+    // (or abandoned by shutdown()).
+    // does nothing if called from one of the worker threads (it would wait for itself).
+    void drain()
+    {
+        if (is_worker_thread_())
+        {
+            return;
+        }
+        auto barrier = std::make_shared<async_barrier>(worker_ids_.size());
+        {
+            // post the barrier msgs contiguously: workers blocked in two interleaved barriers would deadlock
+            std::unique_lock<std::mutex> lock(barrier_mutex_);
+            if (stopped_)
+            {
+                lock.unlock();
+                wait_shutdown_done_();
+                return;
+            }
+            for (size_t i = 0; i < worker_ids_.size(); i++)
+            {
+                post_async_msg_(queue_of_worker_(i), async_msg(barrier), async_overflow_policy::block);
+            }
+        }
+        barrier->wait();
+    }
 
-    void post_async_msg_(async_msg &&new_msg, async_overflow_policy overflow_policy)
+    // block until every msg of the logger posted before this call was processed (or
+    // abandoned by shutdown()) - see ~async_logger(). Unlike drain(), only waits for the
+    // queue of the logger, with a barrier msg per worker consuming it.
+    // does nothing if called from one of the worker threads (it would wait for itself).
+    void drain_logger(async_logger_ptr worker_ptr)
     {
-        if (overflow_policy == async_overflow_policy::block)
+        if (is_worker_thread_())
         {
-            q_.enqueue(std::move(new_msg));
+            return;
         }
-        else
+        post_logger_barrier_(worker_ptr, async_msg_type::barrier, nullptr).wait();
+        if (stopped_.load(std::memory_order_relaxed))
+        {
+            // the barrier failed or was abandoned: wait for the workers to let go of the msgs
+            wait_shutdown_done_();
+        }
+    }
+
+    // flush the logger once every msg posted before this call was processed.
+    // the returned future is ready after the flush (or holds a spdlog_ex if a
+    // flush msg was discarded, e.g. overrun by async_overflow_policy::overrun_oldest).
+    std::future<void> post_flush_barrier(async_logger_ptr worker_ptr)
+    {
+        if (is_worker_thread_())
         {
-            q_.enqueue_nowait(std::move(new_msg));
+            throw spdlog_ex("async flush barrier: can't wait for the thread pool from its own worker threads");
         }
+        return post_logger_barrier_(worker_ptr, async_msg_type::flush, [worker_ptr] { worker_ptr->backend_flush_(); });
     }
 
-    void worker_loop_()
+    // run fn on the single worker thread consuming the logger's msgs (see single_consumer_of()),
+    // once every msg posted before this call was processed - right away if called from that thread.
+    // the returned future holds fn's exception if it throws.
+    std::future<void> post_to_consumer(async_logger_ptr worker_ptr, std::function<void()> fn)
     {
-        while (process_next_msg_()) {};
+        const void *consumer = single_consumer_of(worker_ptr);
+        if (consumer == nullptr)
+        {
+            throw spdlog_ex("spdlog::thread_pool::post_to_consumer(): the logger's msgs have several consumers");
+        }
+        if (!is_worker_thread_())
+        {
+            return post_logger_barrier_(worker_ptr, async_msg_type::barrier, std::move(fn));
+        }
+        if (&queue_of_worker_(worker_index_()) != consumer)
+        {
+            throw spdlog_ex("spdlog::thread_pool::post_to_consumer(): can't wait for another worker thread");
+        }
+        std::promise<void> done;
+        try
+        {
+            fn();
+            done.set_value();
+        }
+        catch (...)
+        {
+            done.set_exception(std::current_exception());
+        }
+        return done.get_future();
     }
 
-    // process next message in the queue
-    // return true if this thread should still be active (while no terminate msg
-    // was received)
-    bool process_next_msg_()
+    // stop the worker threads within timeout.
+    // the workers process the backlog until then, and the log msgs still queued at
+    // the deadline are abandoned - appended as raw lines to spill_filename, unless empty.
+    // the pool takes no more msgs afterwards (post_log() returns false).
+    // Note: a sink call in progress at the deadline can't be interrupted - it is waited for.
+    thread_pool_shutdown_stats shutdown(std::chrono::milliseconds timeout, const filename_t &spill_filename = filename_t())
     {
-        async_msg incoming_async_msg;
-        bool dequeued = q_.dequeue_for(incoming_async_msg, std::chrono::seconds(10));
-        if (!dequeued)
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        thread_pool_shutdown_stats rv;
+        if (is_worker_thread_())
         {
-            return true;
+            throw spdlog_ex("spdlog::thread_pool::shutdown(): can't be called from a worker thread");
+        }
+        {
+            std::lock_guard<std::mutex> lock(barrier_mutex_);
+            if (stopped_)
+            {
+                return rv;
+            }
+            stopped_.store(true);
+        }
+        {
+            std::lock_guard<std::mutex> lock(spill_mutex_);
+            spill_filename_ = spill_filename;
         }
+        const uint64_t written_before = stats().written;
 
-        switch (incoming_async_msg.msg_type)
+        // the terminate msgs go after the backlog
+        for (size_t i = 0; i < worker_ids_.size(); i++)
         {
-        case async_msg_type::log:
+            while (!queue_of_worker_(i).try_enqueue(async_msg(async_msg_type::terminate)) && std::chrono::steady_clock::now() < deadline)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        if (!wait_workers_exit_(deadline))
         {
-            auto msg = incoming_async_msg.to_log_msg();
-            incoming_async_msg.worker_ptr->backend_log_(msg);
-            return true;
+            // make the workers abandon their batch after the current msg, and wake up the parked ones
+            rv.timed_out = true;
+            aborting_.store(true);
+            do
+            {
+                for (auto &q : queues_)
+                {
+                    q->try_enqueue(async_msg(async_msg_type::terminate));
+                }
+            } while (!wait_workers_exit_(std::chrono::steady_clock::now() + std::chrono::milliseconds(10)));
         }
-        case async_msg_type::flush:
+        for (auto &t : threads_)
         {
-            incoming_async_msg.worker_ptr->backend_flush_();
-            return true;
+            t.join();
         }
+        threads_.clear();
+        rv.flushed = stats().written - written_before;
 
-        case async_msg_type::terminate:
+        // the workers are gone - take what's left in the queues
+        std::vector<async_msg> leftovers(async_batch_size);
+        for (auto &q : queues_)
         {
-            return false;
+            abandon_queue_(*q, leftovers);
         }
+        leftovers.clear();
+
+        {
+            std::lock_guard<std::mutex> lock(spill_mutex_);
+            rv.abandoned = abandoned_;
+            rv.spilled = spilled_;
+            spill_file_.reset();
+        }
+        {
+            std::lock_guard<std::mutex> lock(stop_mutex_);
+            shutdown_done_ = true;
+        }
+        stop_cv_.notify_all();
+        return rv;
+    }
+
+    // the consumer of the logger's msgs if a single worker thread processes them all
+    // (one worker, or sharded), nullptr otherwise. see logger::claim_sinks_().
+    const void *single_consumer_of(async_logger_ptr worker_ptr)
+    {
+        if (worker_ids_.size() != 1 && queues_.size() != worker_ids_.size())
+        {
+            return nullptr;
+        }
+        return &queue_of_logger_(worker_ptr);
+    }
+
+    size_t overrun_counter()
+    {
+        size_t total = 0;
+        for (auto &q : queues_)
+        {
+            total += q->overrun_counter();
+        }
+        return total;
+    }
+
+    // change the capacity of the queue (of each queue if sharded) without losing queued msgs.
+    // a queue never shrinks below the number of msgs it holds.
+    // throws spdlog_ex with SPDLOG_ASYNC_LOCKFREE_QUEUE / SPDLOG_ASYNC_SPSC_LANES, which can't be resized.
+    void resize_queue(size_t new_capacity)
+    {
+        if (new_capacity == 0)
+        {
+            throw spdlog_ex("spdlog::thread_pool::resize_queue(): invalid capacity 0");
+        }
+#if defined(SPDLOG_ASYNC_LOCKFREE_QUEUE) || defined(SPDLOG_ASYNC_SPSC_LANES)
+        throw spdlog_ex("spdlog::thread_pool::resize_queue(): not supported by the lock-free queues");
+#else
+        std::lock_guard<std::mutex> lock(resize_mutex_);
+        for (auto &q : queues_)
+        {
+            q->resize(new_capacity);
+        }
+#endif
+    }
+
+    // total capacity of the queue(s)
+    size_t queue_capacity() const
+    {
+        size_t total = 0;
+        for (auto &q : queues_)
+        {
+            total += q->capacity();
+        }
+        return total;
+    }
+
+    // aggregate the queue(s) and worker threads counters.
+    // cheap enough to be polled (e.g. to alert before producers start blocking).
+    thread_pool_stats stats()
+    {
+        thread_pool_stats rv;
+        for (auto &q : queues_)
+        {
+            rv.queue_capacity += q->capacity();
+            rv.queue_depth += q->size();
+            rv.overrun += q->overrun_counter();
+            rv.producers_blocked_time += q->blocked_time();
+        }
+        for (auto &w : worker_stats_)
+        {
+            rv.dequeued += w->dequeued.load(std::memory_order_relaxed);
+            rv.written += w->written.load(std::memory_order_relaxed);
+            rv.queue_depth_high_watermark = (std::max)(rv.queue_depth_high_watermark, w->depth_high_watermark.load(std::memory_order_relaxed));
+            for (size_t i = 0; i < async_latency_buckets; i++)
+            {
+                rv.latency_histogram[i] += w->latency_histogram[i].load(std::memory_order_relaxed);
+            }
+        }
+        rv.enqueued = rv.dequeued + rv.overrun + rv.queue_depth;
+        return rv;
+    }
+
+private:
+#if defined(SPDLOG_ASYNC_SHM_JOURNAL)
+    // before the queues: the queued msgs consume their records when destroyed
+    std::unique_ptr<shm_journal> journal_;
+#endif
+    // one queue shared by all the workers, or one per worker if sharded
+    std::vector<std::unique_ptr<q_type>> queues_;
+    const thread_pool_options options_;
+    std::vector<std::unique_ptr<async_worker_stats>> worker_stats_;
+    std::vector<std::unique_ptr<async_worker_batch>> worker_batches_;
+
+    // thread_pool_options::parallel_formatting: the batches are numbered as they are
+    // dequeued, and written to the sinks in that order - one at a time.
+    bool ordered_ = false;
+    std::mutex dequeue_mutex_;
+    uint64_t next_ticket_ = 0;
+    std::mutex turn_mutex_;
+    std::condition_variable turn_cv_;
+    uint64_t turn_ = 0;
+
+    std::vector<std::thread> threads_;
+    std::vector<std::thread::id> worker_ids_; // unlike threads_, not modified once started
+    std::mutex start_mutex_;
+    std::string start_error_;
+    std::mutex barrier_mutex_;
+    std::mutex resize_mutex_;
+
+    // shutdown() state
+    std::atomic<bool> stopped_{false};
+    std::atomic<bool> aborting_{false};
+    std::mutex stop_mutex_;
+    std::condition_variable stop_cv_;
+    size_t running_workers_ = 0;
+    bool shutdown_done_ = false;
+
+    std::mutex spill_mutex_;
+    filename_t spill_filename_;
+    std::unique_ptr<file_helper> spill_file_;
+    uint64_t abandoned_ = 0;
+    uint64_t spilled_ = 0;
+
+    bool is_worker_thread_() const
+    {
+        auto this_id = std::this_thread::get_id();
+        for (auto &id : worker_ids_)
+        {
+            if (id == this_id)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // index of the calling worker thread
+    size_t worker_index_() const
+    {
+        auto this_id = std::this_thread::get_id();
+        return static_cast<size_t>(std::find(worker_ids_.begin(), worker_ids_.end(), this_id) - worker_ids_.begin());
+    }
+
+    q_type &queue_of_worker_(size_t worker_index)
+    {
+        return *queues_[worker_index % queues_.size()];
+    }
+
+    // the msgs of a logger always go to the same queue, so they stay in order
+    q_type &queue_of_logger_(async_logger_ptr worker_ptr)
+    {
+        return queues_.size() == 1 ? *queues_[0] : *queues_[worker_ptr->shard_key_ % queues_.size()];
+    }
+
+    static bool post_async_msg_(q_type &q, async_msg &&new_msg, async_overflow_policy overflow_policy)
+    {
+        switch (overflow_policy)
+        {
+        case async_overflow_policy::block:
+            q.enqueue(std::move(new_msg));
+            return true;
+        case async_overflow_policy::discard_new:
+            return q.try_enqueue(std::move(new_msg));
+        default:
+            q.enqueue_nowait(std::move(new_msg));
+            return true;
+        }
+    }
+
+    // post a barrier msg to the logger's queue for each worker consuming it. the last
+    // worker to reach its msg runs on_completion.
+    std::future<void> post_logger_barrier_(async_logger_ptr worker_ptr, async_msg_type msg_type, std::function<void()> on_completion)
+    {
+        const size_t parties = queues_.size() == 1 ? worker_ids_.size() : 1;
+        auto barrier = std::make_shared<async_barrier>(parties, std::move(on_completion));
+        auto completed = barrier->get_future();
+        {
+            std::lock_guard<std::mutex> lock(barrier_mutex_);
+            if (stopped_)
+            {
+                std::promise<void> failed;
+                failed.set_exception(std::make_exception_ptr(spdlog_ex("async barrier: the thread pool was shut down")));
+                return failed.get_future();
+            }
+            for (size_t i = 0; i < parties; i++)
+            {
+                async_msg barrier_msg(worker_ptr, msg_type);
+                barrier_msg.barrier = async_barrier_token(barrier);
+                post_async_msg_(queue_of_logger_(worker_ptr), std::move(barrier_msg), async_overflow_policy::block);
+            }
+        }
+        return completed;
+    }
+
+    static thread_pool_options make_options_(async_wait_strategy wait_strategy, std::chrono::microseconds spin_budget)
+    {
+        thread_pool_options options;
+        options.wait_strategy = wait_strategy;
+        options.spin_budget = spin_budget;
+        return options;
+    }
+
+    // constructor failure: undo the start and throw
+    void abort_start_(const std::string &error)
+    {
+        stop_workers_();
+#if defined(SPDLOG_ASYNC_SHM_JOURNAL)
+        if (journal_)
+        {
+            journal_->remove();
+        }
+#endif
+        throw spdlog_ex("spdlog::thread_pool(): " + error);
+    }
+
+    void stop_workers_()
+    {
+        for (size_t i = 0; i < threads_.size(); i++)
+        {
+            post_async_msg_(queue_of_worker_(i), async_msg(async_msg_type::terminate), async_overflow_policy::block);
+        }
+
+        for (auto &t : threads_)
+        {
+            t.join();
+        }
+        threads_.clear();
+    }
+
+    // apply the thread options to the calling worker thread
+    void setup_worker_(size_t worker_index)
+    {
+        std::string error;
+        if (!options_.thread_name_prefix.empty())
+        {
+            os::set_thread_name(options_.thread_name_prefix + std::to_string(worker_index));
+        }
+        if (!options_.cpu_affinity.empty() && !os::set_thread_affinity(options_.cpu_affinity[worker_index % options_.cpu_affinity.size()]))
+        {
+            error = "failed to set the cpu affinity of worker thread " + std::to_string(worker_index);
+        }
+        if (options_.sched_policy >= 0 && !os::set_thread_sched(options_.sched_policy, options_.sched_priority))
+        {
+            error = "failed to set the scheduling policy of worker thread " + std::to_string(worker_index);
+        }
+        if (options_.nice != 0 && !os::set_thread_nice(options_.nice))
+        {
+            error = "failed to set the nice value of worker thread " + std::to_string(worker_index);
+        }
+        if (!error.empty())
+        {
+            std::lock_guard<std::mutex> lock(start_mutex_);
+            start_error_ = std::move(error);
+        }
+    }
+
+    void worker_loop_(size_t worker_index, std::shared_ptr<async_barrier> started)
+    {
+        setup_worker_(worker_index);
+        started->arrive_and_wait();
+        // the constructor stops the workers right away if any failed its setup
+        const bool run_hooks = start_error_.empty();
+        started.reset();
+
+        if (run_hooks && options_.on_thread_start)
+        {
+            options_.on_thread_start();
+        }
+        q_type &q = queue_of_worker_(worker_index);
+        std::vector<async_msg> batch(async_batch_size);
+        std::vector<async_logger_ptr> flush_list;
+        fmt::memory_buffer formatted; // deferred formatting output
+        async_worker_stats &stats = *worker_stats_[worker_index];
+        async_worker_batch *published = nullptr;
+        if (options_.crash_dump)
+        {
+            published = worker_batches_[worker_index].get();
+            published->msgs.store(batch.data());
+        }
+        while (process_next_msgs_(q, batch, flush_list, formatted, stats, published)) {};
+        if (run_hooks && options_.on_thread_stop)
+        {
+            options_.on_thread_stop();
+        }
+        {
+            std::lock_guard<std::mutex> lock(stop_mutex_);
+            --running_workers_;
+        }
+        stop_cv_.notify_all();
+    }
+
+    bool wait_workers_exit_(std::chrono::steady_clock::time_point deadline)
+    {
+        std::unique_lock<std::mutex> lock(stop_mutex_);
+        return stop_cv_.wait_until(lock, deadline, [this] { return this->running_workers_ == 0; });
+    }
+
+    void wait_shutdown_done_()
+    {
+        std::unique_lock<std::mutex> lock(stop_mutex_);
+        stop_cv_.wait(lock, [this] { return this->shutdown_done_; });
+    }
+
+    static bool never_stop_(const async_msg &)
+    {
+        return false;
+    }
+
+    // abandon all the msgs left in q (must be called by its consumer)
+    void abandon_queue_(q_type &q, std::vector<async_msg> &batch)
+    {
+        size_t n;
+        while ((n = q.dequeue_bulk_for(batch.data(), batch.size(), std::chrono::milliseconds(0), never_stop_)) > 0)
+        {
+            abandon_(batch, 0, n);
+        }
+    }
+
+    // count the log msgs of batch[from, n) as abandoned and spill them, and release the control msgs
+    void abandon_(std::vector<async_msg> &batch, size_t from, size_t n)
+    {
+        std::lock_guard<std::mutex> lock(spill_mutex_);
+        for (size_t i = from; i < n; i++)
+        {
+            auto &m = batch[i];
+            if (m.msg_type == async_msg_type::log)
+            {
+                ++abandoned_;
+                if (spill_(m))
+                {
+                    ++spilled_;
+                }
+            }
+            m.barrier = async_barrier_token();
+        }
+    }
+
+    // append the msg to the spill file as "[epoch micros] [logger] [level] payload".
+    // return false if there is no spill file, or if it can't be written.
+    bool spill_(const async_msg &m)
+    {
+        if (spill_filename_.empty())
+        {
+            return false;
+        }
+        try
+        {
+            if (!spill_file_)
+            {
+                spill_file_ = details::make_unique<file_helper>();
+                spill_file_->open(spill_filename_);
+            }
+            fmt::memory_buffer line;
+            auto micros = std::chrono::duration_cast<std::chrono::microseconds>(m.time.time_since_epoch()).count();
+            fmt::format_to(line, "[{}] [{}] [{}] ", micros, m.worker_ptr->name(), level::to_string_view(m.level));
+            string_view_t payload(m.raw.data(), m.raw.size());
+            if (m.format_fn != nullptr)
+            {
+                fmt::memory_buffer formatted;
+                if (!m.worker_ptr->backend_format_(m.format_fn, payload.data(), formatted))
+                {
+                    return false;
+                }
+                fmt_helper::append_string_view(fmt_helper::to_string_view(formatted), line);
+            }
+            else
+            {
+                fmt_helper::append_string_view(payload, line);
+            }
+            line.push_back('\n');
+            spill_file_->write(line);
+            return true;
+        }
+        catch (const std::exception &)
+        {
+            spill_filename_.clear(); // don't retry for each msg
+            spill_file_.reset();
+            return false;
+        }
+    }
+
+#if defined(SPDLOG_ASYNC_CRASH_DUMP)
+    // crash_handler callback (called from a signal handler): write the log msgs not
+    // written yet - the workers' batches first, then the queues - to the file sinks of their loggers.
+    static void crash_dump_(void *ctx, crash_writer &writer)
+    {
+        auto *self = static_cast<thread_pool *>(ctx);
+        for (auto &published : self->worker_batches_)
+        {
+            const async_msg *msgs = published->msgs.load(std::memory_order_relaxed);
+            const size_t end = published->end.load(std::memory_order_acquire);
+            for (size_t i = published->next.load(std::memory_order_relaxed); msgs != nullptr && i < end; i++)
+            {
+                crash_dump_msg_(writer, msgs[i], string_view_t(msgs[i].raw.data(), msgs[i].raw.size()));
+            }
+        }
+        for (auto &q : self->queues_)
+        {
+            q->for_each_unsafe([&writer](const async_msg_header &m, string_view_t payload) { crash_dump_msg_(writer, m, payload); });
+        }
+    }
+
+    // a packed log call (SPDLOG_ASYNC_DEFERRED_FORMATTING) can't be formatted in a signal
+    // handler - its format string is written instead.
+    static void crash_dump_msg_(crash_writer &writer, const async_msg_header &m, string_view_t payload)
+    {
+        if (m.msg_type != async_msg_type::log || m.worker_ptr == nullptr)
+        {
+            return;
+        }
+        if (m.format_fn != nullptr)
+        {
+            const char *fmt_str;
+            std::memcpy(&fmt_str, payload.data(), sizeof(fmt_str));
+            payload = string_view_t(fmt_str, std::strlen(fmt_str));
+        }
+        auto micros = std::chrono::duration_cast<std::chrono::microseconds>(m.time.time_since_epoch()).count();
+        const std::string &logger_name = m.worker_ptr->name();
+        for (auto &sink : m.worker_ptr->sinks())
+        {
+            const int fd = sink->native_fd();
+            if (fd >= 0 && sink->should_log(m.level))
+            {
+                writer.write_msg(fd, static_cast<int64_t>(micros), logger_name, level::to_string_view(m.level), payload);
+            }
+        }
+    }
+
+#endif // SPDLOG_ASYNC_CRASH_DUMP
+
+#if defined(SPDLOG_ASYNC_SHM_JOURNAL)
+    // copy the msg to the journal. a packed log call is formatted right away - the
+    // journal must not refer to this process' memory (e.g. the format string).
+    uint64_t journal_msg_(async_logger_ptr worker_ptr, const details::log_msg &msg, deferred_format_fn format_fn)
+    {
+        if (format_fn == nullptr)
+        {
+            return journal_->append(msg, msg.payload);
+        }
+        fmt::memory_buffer formatted;
+        if (!worker_ptr->backend_format_(format_fn, msg.payload.data(), formatted))
+        {
+            return 0;
+        }
+        return journal_->append(msg, fmt_helper::to_string_view(formatted));
+    }
+
+#endif // SPDLOG_ASYNC_SHM_JOURNAL
+
+    static void consume_journal_(async_msg &m)
+    {
+#if defined(SPDLOG_ASYNC_SHM_JOURNAL)
+        m.journal.consume();
+#else
+        (void)m;
+#endif
+    }
+
+    static bool is_control_msg_(const async_msg &m)
+    {
+        return m.msg_type != async_msg_type::log;
+    }
+
+    // process the next batch of messages in the queue (in order).
+    // flushes are deferred to the end of the batch, so each logger that needs
+    // it is flushed once per batch instead of once per message.
+    // return true if this thread should still be active (while no terminate msg
+    // was received)
+    // published - the batch state for the crash dump, if enabled
+    bool process_next_msgs_(q_type &q, std::vector<async_msg> &batch, std::vector<async_logger_ptr> &flush_list,
+        fmt::memory_buffer &formatted, async_worker_stats &stats, async_worker_batch *published)
+    {
+        // a batch never extends past a control message (e.g. so one thread can't swallow the terminate msg of another)
+        uint64_t ticket = 0;
+        size_t n = ordered_ ? dequeue_ordered_batch_(q, batch, ticket) : dequeue_batch_(q, batch);
+        bool my_turn = false;
+        if (n > 0)
+        {
+            update_depth_stats_(q, n, stats);
+            auto_grow_(q);
+            if (published != nullptr)
+            {
+                published->next.store(0, std::memory_order_relaxed);
+                published->end.store(n, std::memory_order_release);
+            }
+            if (ordered_)
+            {
+                // format while the other workers write the previous batches
+                preformat_batch_(batch, n, formatted);
+                wait_turn_(ticket);
+                my_turn = true;
+            }
+        }
+        bool active = true;
+        uint64_t written = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            if (published != nullptr)
+            {
+                published->next.store(i, std::memory_order_relaxed);
+            }
+            if (aborting_.load(std::memory_order_relaxed))
+            {
+                // shutdown() deadline passed. empty the queue too: it may hold barrier msgs other workers wait for
+                abandon_(batch, i, n);
+                abandon_queue_(q, batch);
+                n = i;
+                active = false;
+                break;
+            }
+            auto &incoming_async_msg = batch[i];
+            switch (incoming_async_msg.msg_type)
+            {
+            case async_msg_type::log:
+            {
+                string_view_t payload(incoming_async_msg.raw.data(), incoming_async_msg.raw.size());
+                if (incoming_async_msg.format_fn != nullptr)
+                {
+                    if (!incoming_async_msg.worker_ptr->backend_format_(incoming_async_msg.format_fn, payload.data(), formatted))
+                    {
+                        consume_journal_(incoming_async_msg);
+                        break;
+                    }
+                    payload = fmt_helper::to_string_view(formatted);
+                }
+                auto msg = incoming_async_msg.to_log_msg(payload);
+                incoming_async_msg.worker_ptr->backend_sink_it_(msg);
+                consume_journal_(incoming_async_msg);
+                ++written;
+                if (incoming_async_msg.worker_ptr->should_flush_(msg))
+                {
+                    add_to_flush_list_(flush_list, incoming_async_msg.worker_ptr);
+                }
+                break;
+            }
+            case async_msg_type::flush:
+            {
+                if (incoming_async_msg.barrier)
+                {
+                    // flush barrier - the last worker to arrive flushes the logger
+                    flush_loggers_(flush_list);
+                    end_turn_(my_turn); // the other workers must reach their barrier msgs
+                    incoming_async_msg.barrier.arrive_and_wait();
+                }
+                else
+                {
+                    add_to_flush_list_(flush_list, incoming_async_msg.worker_ptr);
+                }
+                break;
+            }
+            case async_msg_type::barrier:
+            {
+                // the loggers waiting on the barrier may be destroyed right after it
+                flush_loggers_(flush_list);
+                end_turn_(my_turn);
+                incoming_async_msg.barrier.arrive_and_wait();
+                break;
+            }
+            case async_msg_type::terminate:
+            {
+                active = false;
+                break;
+            }
+            case async_msg_type::discarded:
+            {
+                consume_journal_(incoming_async_msg);
+                break;
+            }
+            default:
+            {
+                assert(false && "Unexpected async_msg_type");
+            }
+            }
+        }
+
+        if (published != nullptr)
+        {
+            published->end.store(0, std::memory_order_release);
+        }
+        async_worker_stats::add<uint64_t>(stats.written, written);
+        update_latency_stats_(batch, n, stats);
+        flush_loggers_(flush_list);
+        end_turn_(my_turn);
+        return active;
+    }
+
+    // dequeue the next batch and number it (thread_pool_options::parallel_formatting).
+    // one worker waits for msgs at a time, the others wait for it to take its batch.
+    size_t dequeue_ordered_batch_(q_type &q, std::vector<async_msg> &batch, uint64_t &ticket)
+    {
+        std::lock_guard<std::mutex> lock(dequeue_mutex_);
+        size_t n = dequeue_batch_(q, batch);
+        if (n > 0)
+        {
+            ticket = next_ticket_++;
+        }
+        return n;
+    }
+
+    // format the packed log calls of the batch into their own payload, so the writing
+    // stage (in turn) only calls the sinks
+    static void preformat_batch_(std::vector<async_msg> &batch, size_t n, fmt::memory_buffer &formatted)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            auto &m = batch[i];
+            if (m.msg_type != async_msg_type::log || m.format_fn == nullptr)
+            {
+                continue;
+            }
+            if (!m.worker_ptr->backend_format_(m.format_fn, m.raw.data(), formatted))
+            {
+                m.msg_type = async_msg_type::discarded;
+                continue;
+            }
+            m.format_fn = nullptr; // first: the crash dump reads the payload as a packed log call while set
+            m.raw.clear();
+            fmt_helper::append_buf(formatted, m.raw);
+        }
+    }
+
+    // wait until every batch dequeued before the ticket's one was written
+    void wait_turn_(uint64_t ticket)
+    {
+        std::unique_lock<std::mutex> lock(turn_mutex_);
+        turn_cv_.wait(lock, [this, ticket] { return this->turn_ == ticket; });
+    }
+
+    // let the next batch be written (once per batch)
+    void end_turn_(bool &my_turn)
+    {
+        if (!my_turn)
+        {
+            return;
+        }
+        my_turn = false;
+        {
+            std::lock_guard<std::mutex> lock(turn_mutex_);
+            ++turn_;
+        }
+        turn_cv_.notify_all();
+    }
+
+    // called once per batch: n msgs were just dequeued from q.
+    // the depth is sampled right after (what the batch left behind) - the producers
+    // may have refilled the queue in between, so adding n would overshoot.
+    static void update_depth_stats_(q_type &q, size_t n, async_worker_stats &stats)
+    {
+        async_worker_stats::add<uint64_t>(stats.dequeued, n);
+        size_t depth = q.size();
+        if (depth > stats.depth_high_watermark.load(std::memory_order_relaxed))
+        {
+            stats.depth_high_watermark.store(depth, std::memory_order_relaxed);
+        }
+    }
+
+    // double the queue if it is full after a batch (thread_pool_options::auto_grow_max_items)
+    void auto_grow_(q_type &q)
+    {
+#if !defined(SPDLOG_ASYNC_LOCKFREE_QUEUE) && !defined(SPDLOG_ASYNC_SPSC_LANES)
+        const size_t capacity = q.capacity();
+        if (capacity >= options_.auto_grow_max_items || !q.full())
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(resize_mutex_);
+        if (q.capacity() == capacity) // not resized by another thread meanwhile
+        {
+            q.resize((std::min)(capacity * 2, options_.auto_grow_max_items));
+        }
+#else
+        (void)q;
+#endif
+    }
+
+    // one clock read per batch - each log msg is accounted as written when its whole batch is
+    static void update_latency_stats_(const std::vector<async_msg> &batch, size_t n, async_worker_stats &stats)
+    {
+#ifndef SPDLOG_NO_DATETIME
+        if (n == 0)
+        {
+            return;
+        }
+        const auto now = log_clock::now();
+        for (size_t i = 0; i < n; i++)
+        {
+            if (batch[i].msg_type != async_msg_type::log)
+            {
+                continue;
+            }
+            auto micros = std::chrono::duration_cast<std::chrono::microseconds>(now - batch[i].time).count();
+            size_t bucket = 0;
+            while (micros > 0 && bucket < async_latency_buckets - 1)
+            {
+                micros >>= 1;
+                ++bucket;
+            }
+            async_worker_stats::add<uint64_t>(stats.latency_histogram[bucket], 1);
+        }
+#else
+        (void)batch;
+        (void)n;
+        (void)stats;
+#endif
+    }
+
+    // wait for the next messages according to the wait strategy
+    size_t dequeue_batch_(q_type &q, std::vector<async_msg> &batch)
+    {
+        const auto wait_strategy = options_.wait_strategy;
+        if (wait_strategy != async_wait_strategy::block)
+        {
+            const auto spin_until = std::chrono::steady_clock::now() + options_.spin_budget;
+            for (;;)
+            {
+                size_t n = q.try_dequeue_bulk(batch.data(), batch.size(), is_control_msg_);
+                if (n > 0)
+                {
+                    return n;
+                }
+                if (wait_strategy == async_wait_strategy::spin_yield)
+                {
+                    std::this_thread::yield();
+                }
+                else if (wait_strategy == async_wait_strategy::busy_spin)
+                {
+                    os::cpu_relax();
+                }
+                else if (std::chrono::steady_clock::now() < spin_until)
+                {
+                    os::cpu_relax();
+                }
+                else
+                {
+                    break; // spin budget exhausted - park
+                }
+            }
+        }
+        return q.dequeue_bulk_for(batch.data(), batch.size(), std::chrono::seconds(10), is_control_msg_);
+    }
+
+    static void flush_loggers_(std::vector<async_logger_ptr> &flush_list)
+    {
+        for (auto &worker_ptr : flush_list)
+        {
+            worker_ptr->backend_flush_();
+        }
+        flush_list.clear();
+    }
+
+    static void add_to_flush_list_(std::vector<async_logger_ptr> &flush_list, async_logger_ptr worker_ptr)
+    {
+        if (std::find(flush_list.begin(), flush_list.end(), worker_ptr) == flush_list.end())
+        {
+            flush_list.push_back(worker_ptr);
         }
-        assert(false && "Unexpected async_msg_type");
-        return true;
     }
 };
 
@@ -0,0 +1,290 @@
+//
+// Copyright(c) 2019 Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+#pragma once
+
+// cheap wall clock for the log msgs time (SPDLOG_CLOCK_TSC).
+// Reads the cpu's timestamp counter (rdtsc on x86, cntvct_el0 on aarch64) and
+// converts it to log_clock time with a calibration that a periodic_worker
+// refreshes every second: each refresh anchors the counter to log_clock::now()
+// again, and derives the counter's rate from the last interval.
+// Sub microsecond resolution for a fraction of the cost of clock_gettime().
+//
+// The time never steps back at a refresh: if the counter ran ahead of the system
+// clock, the next interval runs slower until it caught up. The time of the msgs
+// of a thread never goes back either (it stalls instead, e.g. until the first refresh).
+// Until the first refresh, and on other cpus, log_clock::now() is used.
+// Requires an invariant counter (constant rate, synchronized across cores), as
+// provided by the x86 cpus of the last decade (checked with cpuid) and by aarch64.
+// log_clock::now() is used if the counter isn't invariant.
+//
+// The calibration thread starts with the first log msg, and stops at exit or
+// on spdlog::shutdown() (stop_calibration()) - the last calibration is kept then.
+
+#include "spdlog/common.h"
+#include "spdlog/details/periodic_worker.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#define SPDLOG_HAS_TSC 1
+#elif defined(__aarch64__)
+#define SPDLOG_HAS_TSC 1
+#endif
+
+namespace spdlog {
+namespace details {
+
+class tsc_clock
+{
+public:
+    static log_clock::time_point now() SPDLOG_NOEXCEPT
+    {
+#ifdef SPDLOG_HAS_TSC
+        const tsc_clock &clock = instance_();
+        if (clock.invariant_)
+        {
+            return not_before_last_(clock.to_time_point_(read_counter()));
+        }
+#endif
+        return log_clock::now();
+    }
+
+    static uint64_t read_counter() SPDLOG_NOEXCEPT
+    {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        uint64_t ticks;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+        return ticks;
+#else
+        return 0;
+#endif
+    }
+
+    // true if the counter runs at a constant rate, synchronized across cores
+    static bool invariant_counter() SPDLOG_NOEXCEPT
+    {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+        // cpuid leaf 0x80000007, edx bit 8: invariant tsc
+#ifdef _MSC_VER
+        int regs[4];
+        __cpuid(regs, static_cast<int>(0x80000000));
+        if (static_cast<unsigned>(regs[0]) < 0x80000007u)
+        {
+            return false;
+        }
+        __cpuid(regs, static_cast<int>(0x80000007));
+        return (static_cast<unsigned>(regs[3]) & (1u << 8)) != 0;
+#else
+        unsigned eax, ebx, ecx, edx;
+        if (__get_cpuid_max(0x80000000u, nullptr) < 0x80000007u)
+        {
+            return false;
+        }
+        __cpuid(0x80000007u, eax, ebx, ecx, edx);
+        return (edx & (1u << 8)) != 0;
+#endif
+#elif defined(__aarch64__)
+        return true; // the generic timer has a fixed frequency, common to all cores
+#else
+        return false;
+#endif
+    }
+
+    // stop the calibration thread (spdlog::shutdown()). the last calibration is used from then on.
+    static void stop_calibration()
+    {
+        if (auto *owner = calibration_thread::instance())
+        {
+            std::lock_guard<std::mutex> lock(owner->mutex);
+            owner->worker.reset();
+        }
+    }
+
+private:
+    // owns the calibration thread, so it is joined at exit. the calibration itself
+    // (tsc_clock) is never destroyed.
+    struct calibration_thread
+    {
+        std::mutex mutex;
+        std::unique_ptr<periodic_worker> worker;
+
+        calibration_thread()
+        {
+            alive_() = true;
+        }
+
+        ~calibration_thread()
+        {
+            alive_() = false;
+        }
+
+        // nullptr once destroyed
+        static calibration_thread *instance()
+        {
+            static calibration_thread owner;
+            return alive_() ? &owner : nullptr;
+        }
+
+        // trivially destructible, so still readable after the owner's destruction
+        static bool &alive_()
+        {
+            static bool alive = false;
+            return alive;
+        }
+    };
+
+    tsc_clock()
+        : invariant_(invariant_counter())
+    {
+        if (!invariant_)
+        {
+            return;
+        }
+        sample_(anchor_ticks_, anchor_ns_);
+        if (auto *owner = calibration_thread::instance())
+        {
+            std::lock_guard<std::mutex> lock(owner->mutex);
+            owner->worker = details::make_unique<periodic_worker>([this] { this->calibrate_(); }, std::chrono::seconds(1));
+        }
+    }
+
+    // never destroyed: log msgs may be timed until the very end of the process
+    static tsc_clock &instance_()
+    {
+        static tsc_clock *instance = new tsc_clock();
+        return *instance;
+    }
+
+    // a counter value and the log_clock time (in ns since epoch) it was read at
+    static void sample_(uint64_t &ticks, int64_t &ns)
+    {
+        const uint64_t before = read_counter();
+        ns = std::chrono::duration_cast<std::chrono::nanoseconds>(log_clock::now().time_since_epoch()).count();
+        const uint64_t after = read_counter();
+        ticks = before + (after - before) / 2;
+    }
+
+    // called by the periodic worker: anchor the counter again, at the rate of the last interval
+    void calibrate_()
+    {
+        uint64_t ticks;
+        int64_t ns;
+        sample_(ticks, ns);
+        if (ticks <= anchor_ticks_ || ns <= anchor_ns_)
+        {
+            return; // the system clock was set back - wait for the next interval
+        }
+        const int64_t interval_ns = ns - anchor_ns_;
+        double ns_per_tick = static_cast<double>(interval_ns) / static_cast<double>(ticks - anchor_ticks_);
+        anchor_ticks_ = ticks;
+        anchor_ns_ = ns;
+
+        // don't step back if the counter ran ahead of the system clock: go on from the
+        // current time, slower, to catch up with the system clock over the next interval
+        int64_t base_ns = ns;
+        const int64_t lead = mult_.load(std::memory_order_relaxed) != 0 ? to_ns_(ticks) - ns : 0;
+        if (lead > 0)
+        {
+            base_ns = ns + lead;
+            ns_per_tick *= lead < interval_ns / 2 ? static_cast<double>(interval_ns - lead) / static_cast<double>(interval_ns) : 0.5;
+        }
+        // ns per tick in 32.32 fixed point
+        const auto mult = static_cast<uint64_t>(ns_per_tick * 4294967296.0);
+
+        // seqlock: readers retry while seq_ is odd or changed
+        const uint64_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        base_ticks_.store(ticks, std::memory_order_relaxed);
+        base_ns_.store(base_ns, std::memory_order_relaxed);
+        mult_.store(mult, std::memory_order_relaxed);
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    log_clock::time_point to_time_point_(uint64_t ticks) const SPDLOG_NOEXCEPT
+    {
+        const int64_t ns = to_ns_(ticks);
+        if (ns == 0)
+        {
+            return log_clock::now(); // not calibrated yet
+        }
+        return log_clock::time_point(std::chrono::duration_cast<log_clock::duration>(std::chrono::nanoseconds(ns)));
+    }
+
+    // the counter value as ns since epoch (0 if not calibrated yet)
+    int64_t to_ns_(uint64_t ticks) const SPDLOG_NOEXCEPT
+    {
+        uint64_t base_ticks, mult;
+        int64_t base_ns;
+        uint64_t seq;
+        do
+        {
+            seq = seq_.load(std::memory_order_acquire);
+            base_ticks = base_ticks_.load(std::memory_order_relaxed);
+            base_ns = base_ns_.load(std::memory_order_relaxed);
+            mult = mult_.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((seq & 1) != 0 || seq != seq_.load(std::memory_order_relaxed));
+
+        if (mult == 0)
+        {
+            return 0;
+        }
+        // (read before the anchor on another core: back from the anchor)
+        return ticks >= base_ticks ? base_ns + scale_(ticks - base_ticks, mult) : base_ns - scale_(base_ticks - ticks, mult);
+    }
+
+    // delta ticks in ns, at mult ns per tick (32.32 fixed point)
+    static int64_t scale_(uint64_t delta, uint64_t mult) SPDLOG_NOEXCEPT
+    {
+#ifdef __SIZEOF_INT128__
+        return static_cast<int64_t>((static_cast<unsigned __int128>(delta) * mult) >> 32);
+#else
+        // (delta * mult) >> 32 in 64 bits - mult < 2^32 for counters faster than 1GHz
+        return static_cast<int64_t>((delta >> 32) * mult + (((delta & 0xffffffffu) * mult) >> 32));
+#endif
+    }
+
+    // the time of the calling thread's msgs never goes back
+    static log_clock::time_point not_before_last_(log_clock::time_point t) SPDLOG_NOEXCEPT
+    {
+#ifndef SPDLOG_NO_TLS
+        static thread_local log_clock::time_point last;
+        if (t < last)
+        {
+            return last;
+        }
+        last = t;
+#endif
+        return t;
+    }
+
+    const bool invariant_;
+
+    // owned by the calibrating thread
+    uint64_t anchor_ticks_ = 0;
+    int64_t anchor_ns_ = 0;
+
+    // published calibration
+    std::atomic<uint64_t> seq_{0};
+    std::atomic<uint64_t> base_ticks_{0};
+    std::atomic<int64_t> base_ns_{0};
+    std::atomic<uint64_t> mult_{0};
+};
+} // namespace details
+} // namespace spdlog
@@ -19,10 +19,13 @@
 // and support customize format per each sink.
 
 #include "spdlog/common.h"
+#include "spdlog/details/compiled_format.h"
+#include "spdlog/details/deferred_args.h"
 #include "spdlog/formatter.h"
 #include "spdlog/sinks/sink.h"
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -70,6 +73,33 @@ public:
     template<typename... Args>
     void critical(const char *fmt, const Args &... args);
 
+#ifdef SPDLOG_HAS_COMPILED_FORMAT
+    // S is a format string checked at compile time (SPDLOG_FMT, see details/compiled_format.h)
+    template<typename S, typename... Args, typename std::enable_if<details::is_compiled_format<S>::value, int>::type = 0>
+    void log(level::level_enum lvl, const S &fmt, const Args &... args);
+
+    template<typename S, typename... Args, typename std::enable_if<details::is_compiled_format<S>::value, int>::type = 0>
+    void log(source_loc loc, level::level_enum lvl, const S &fmt, const Args &... args);
+
+    template<typename S, typename... Args, typename std::enable_if<details::is_compiled_format<S>::value, int>::type = 0>
+    void trace(const S &fmt, const Args &... args);
+
+    template<typename S, typename... Args, typename std::enable_if<details::is_compiled_format<S>::value, int>::type = 0>
+    void debug(const S &fmt, const Args &... args);
+
+    template<typename S, typename... Args, typename std::enable_if<details::is_compiled_format<S>::value, int>::type = 0>
+    void info(const S &fmt, const Args &... args);
+
+    template<typename S, typename... Args, typename std::enable_if<details::is_compiled_format<S>::value, int>::type = 0>
+    void warn(const S &fmt, const Args &... args);
+
+    template<typename S, typename... Args, typename std::enable_if<details::is_compiled_format<S>::value, int>::type = 0>
+    void error(const S &fmt, const Args &... args);
+
+    template<typename S, typename... Args, typename std::enable_if<details::is_compiled_format<S>::value, int>::type = 0>
+    void critical(const S &fmt, const Args &... args);
+#endif // SPDLOG_HAS_COMPILED_FORMAT
+
 #ifdef SPDLOG_WCHAR_TO_UTF8_SUPPORT
 #ifndef _WIN32
 #error SPDLOG_WCHAR_TO_UTF8_SUPPORT only supported on windows
@@ -108,12 +138,14 @@ public:
     template<class T, typename std::enable_if<std::is_convertible<T, spdlog::string_view_t>::value, T>::type * = nullptr>
     void log(source_loc loc, level::level_enum lvl, const T &);
 
-    // T cannot be statically converted to string_view
-    template<class T, typename std::enable_if<!std::is_convertible<T, spdlog::string_view_t>::value, T>::type * = nullptr>
+    // T cannot be statically converted to string_view (and is not a SPDLOG_FMT format string)
+    template<class T, typename std::enable_if<!std::is_convertible<T, spdlog::string_view_t>::value && !details::is_compiled_format<T>::value,
+                          T>::type * = nullptr>
     void log(level::level_enum lvl, const T &);
 
-    // T cannot be statically converted to string_view
-    template<class T, typename std::enable_if<!std::is_convertible<T, spdlog::string_view_t>::value, T>::type * = nullptr>
+    // T cannot be statically converted to string_view (and is not a SPDLOG_FMT format string)
+    template<class T, typename std::enable_if<!std::is_convertible<T, spdlog::string_view_t>::value && !details::is_compiled_format<T>::value,
+                          T>::type * = nullptr>
     void log(source_loc loc, level::level_enum lvl, const T &);
 
     template<typename T>
@@ -134,6 +166,14 @@ public:
     template<typename T>
     void critical(const T &msg);
 
+    // call fn() only if lvl is enabled, and log its result (as log(lvl, msg) does) - for
+    // msgs that are expensive to build, e.g. log_lazy(level::debug, [&] { return req.dump(); })
+    template<typename F>
+    void log_lazy(level::level_enum lvl, const F &fn);
+
+    template<typename F>
+    void log_lazy(source_loc loc, level::level_enum lvl, const F &fn);
+
     bool should_log(level::level_enum msg_level) const;
     void set_level(level::level_enum log_level);
 
@@ -143,7 +183,7 @@ public:
 
     // set formatting for the sinks in this logger.
     // each sink will get a seperate instance of the formatter object.
-    void set_formatter(std::unique_ptr<formatter> formatter);
+    virtual void set_formatter(std::unique_ptr<formatter> formatter);
     void set_pattern(std::string pattern, pattern_time_type time_type = pattern_time_type::local);
 
     // flush functions
@@ -151,10 +191,18 @@ public:
     void flush_on(level::level_enum log_level);
     level::level_enum flush_level() const;
 
-    // sinks
+    // sinks.
+    // not thread safe: change them while no other thread uses the logger.
+    // a sink that isn't thread safe (e.g. a *_st sink) must be added with add_sink(), which
+    // claims it like the constructor does - the sinks added through sinks() aren't checked.
     const std::vector<sink_ptr> &sinks() const;
     std::vector<sink_ptr> &sinks();
 
+    // add a sink - throws spdlog_ex (and doesn't add it) if it isn't thread safe and
+    // another thread already feeds it (see claim_sink_()).
+    void add_sink(sink_ptr sink);
+    void remove_sink(const sink_ptr &sink);
+
     // error handler
     void set_error_handler(log_err_handler err_handler);
     log_err_handler error_handler() const;
@@ -163,9 +211,30 @@ public:
     virtual std::shared_ptr<logger> clone(std::string logger_name);
 
 protected:
+    // for derived loggers that claim their sinks themselves, once constructed
+    struct no_sinks_claim
+    {
+    };
+
+    template<typename It>
+    logger(std::string name, It begin, It end, no_sinks_claim);
+
     virtual void sink_it_(details::log_msg &msg);
     virtual void flush_();
 
+#if defined(SPDLOG_ASYNC_DEFERRED_FORMATTING)
+    // sink a msg whose payload is a packed log call, to be formatted later by format_fn.
+    // return false if the logger can't defer formatting (the caller then formats it right away).
+    // only called if defers_formatting_ is set.
+    virtual bool sink_deferred_(details::log_msg &msg, details::deferred_format_fn format_fn);
+
+    template<typename... Args>
+    bool log_deferred_(std::true_type, source_loc source, level::level_enum lvl, const char *fmt, const Args &... args);
+
+    template<typename... Args>
+    bool log_deferred_(std::false_type, source_loc source, level::level_enum lvl, const char *fmt, const Args &... args);
+#endif
+
     bool should_flush_(const details::log_msg &msg);
 
     // default error handler.
@@ -175,6 +244,14 @@ protected:
     // increment the message count (only if defined(SPDLOG_ENABLE_MESSAGE_COUNTER))
     void incr_msg_counter_(details::log_msg &msg);
 
+    // claim the sinks that aren't thread safe for sinks_consumer_ (see sink::claim_consumer()),
+    // once sinks_consumer_ is set by the constructor. return the error if one is rejected.
+    std::string claim_sinks_();
+    // claim the sink if it isn't thread safe. return the error if it's rejected.
+    // must be called with claim_mutex_ locked.
+    std::string claim_sink_(const sink_ptr &sink);
+    void release_sinks_();
+
     const std::string name_;
     std::vector<sink_ptr> sinks_;
     spdlog::level_t level_{spdlog::logger::default_level()};
@@ -182,6 +259,17 @@ protected:
     log_err_handler err_handler_{[this](const std::string &msg) { this->default_err_handler_(msg); }};
     std::atomic<time_t> last_err_time_{0};
     std::atomic<size_t> msg_counter_{1};
+
+    // the thread(s) feeding the sinks that aren't thread safe: the calling threads
+    // (sink::sync_consumer()), or a worker thread of async loggers
+    const void *sinks_consumer_{nullptr};
+    std::mutex claim_mutex_;
+    std::vector<sink_ptr> claimed_sinks_;
+
+#if defined(SPDLOG_ASYNC_DEFERRED_FORMATTING)
+    // set by the loggers that override sink_deferred_ - the others skip the packing
+    bool defers_formatting_{false};
+#endif
 };
 } // namespace spdlog
 
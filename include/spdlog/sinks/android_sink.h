@@ -44,7 +44,8 @@ protected:
     void sink_it_(const details::log_msg &msg) override
     {
         const android_LogPriority priority = convert_to_android_(msg.level);
-        fmt::memory_buffer formatted;
+        details::scoped_format_buffer scoped_buf;
+        fmt::memory_buffer &formatted = scoped_buf.get();
         if (use_raw_msg_)
         {
             details::fmt_helper::append_string_view(msg.payload, formatted);
@@ -17,6 +17,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 
 namespace spdlog {
@@ -53,6 +54,11 @@ public:
     ansicolor_sink(const ansicolor_sink &other) = delete;
     ansicolor_sink &operator=(const ansicolor_sink &other) = delete;
 
+    bool thread_safe() const override
+    {
+        return !std::is_same<mutex_t, details::null_mutex>::value;
+    }
+
     void set_color(level::level_enum color_level, const std::string &color)
     {
         std::lock_guard<mutex_t> lock(mutex_);
@@ -95,7 +101,8 @@ public:
         // If color is not supported in the terminal, log as is instead.
         std::lock_guard<mutex_t> lock(mutex_);
 
-        fmt::memory_buffer formatted;
+        details::scoped_format_buffer scoped_buf;
+        fmt::memory_buffer &formatted = scoped_buf.get();
         formatter_->format(msg, formatted);
         if (should_do_colors_ && msg.color_range_end > msg.color_range_start)
         {
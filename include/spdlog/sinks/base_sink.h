@@ -13,9 +13,12 @@
 
 #include "spdlog/common.h"
 #include "spdlog/details/log_msg.h"
+#include "spdlog/details/null_mutex.h"
 #include "spdlog/formatter.h"
 #include "spdlog/sinks/sink.h"
 
+#include <type_traits>
+
 namespace spdlog {
 namespace sinks {
 template<typename Mutex>
@@ -50,6 +53,11 @@ public:
         set_formatter_(std::move(sink_formatter));
     }
 
+    bool thread_safe() const override
+    {
+        return !std::is_same<Mutex, details::null_mutex>::value;
+    }
+
 protected:
     virtual void sink_it_(const details::log_msg &msg) = 0;
     virtual void flush_() = 0;
@@ -30,10 +30,16 @@ public:
         file_helper_.open(filename, truncate);
     }
 
+    int native_fd() const override
+    {
+        return file_helper_.native_fd();
+    }
+
 protected:
     void sink_it_(const details::log_msg &msg) override
     {
-        fmt::memory_buffer formatted;
+        details::scoped_format_buffer scoped_buf;
+        fmt::memory_buffer &formatted = scoped_buf.get();
         sink::formatter_->format(msg, formatted);
         file_helper_.write(formatted);
     }
@@ -63,6 +63,11 @@ public:
         rotation_tp_ = next_rotation_tp_();
     }
 
+    int native_fd() const override
+    {
+        return file_helper_.native_fd();
+    }
+
 protected:
     void sink_it_(const details::log_msg &msg) override
     {
@@ -72,7 +77,8 @@ protected:
             file_helper_.open(FileNameCalc::calc_filename(base_filename_, now_tm(msg.time)), truncate_);
             rotation_tp_ = next_rotation_tp_();
         }
-        fmt::memory_buffer formatted;
+        details::scoped_format_buffer scoped_buf;
+        fmt::memory_buffer &formatted = scoped_buf.get();
         sink::formatter_->format(msg, formatted);
         file_helper_.write(formatted);
     }
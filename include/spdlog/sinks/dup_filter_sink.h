@@ -0,0 +1,150 @@
+//
+// Copyright(c) 2019 Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+//
+
+#pragma once
+
+#ifndef SPDLOG_H
+#include "spdlog/spdlog.h"
+#endif
+
+#include "dist_sink.h"
+#include "spdlog/details/format_buffer.h"
+#include "spdlog/details/log_msg.h"
+#include "spdlog/details/null_mutex.h"
+
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+// Duplicate message removing sink.
+// Skips a message if it is the same as the previous one (same level and payload)
+// and arrives within max_skip_duration of the last one written. The end of a run
+// of skipped messages is reported by a "last message repeated N times" message:
+// before the next different message, before the repeated message once it is
+// written again (at most once per max_skip_duration), or on flush once
+// max_skip_duration passed.
+//
+// Example:
+//
+//     #include "spdlog/sinks/dup_filter_sink.h"
+//
+//     int main() {
+//         auto dup_filter = std::make_shared<spdlog::sinks::dup_filter_sink_mt>(std::chrono::seconds(5));
+//         dup_filter->add_sink(std::make_shared<spdlog::sinks::stdout_color_sink_mt>());
+//         spdlog::logger l("logger", dup_filter);
+//         l.info("Hello");
+//         l.info("Hello");
+//         l.info("Hello");
+//         l.info("Different Hello");
+//     }
+//
+// Will produce:
+//       [2019-06-25 17:50:56.511] [logger] [info] Hello
+//       [2019-06-25 17:50:56.512] [logger] [info] last message repeated 2 times
+//       [2019-06-25 17:50:56.512] [logger] [info] Different Hello
+
+namespace spdlog {
+namespace sinks {
+template<typename Mutex>
+class dup_filter_sink : public dist_sink<Mutex>
+{
+public:
+    template<class Rep, class Period>
+    explicit dup_filter_sink(std::chrono::duration<Rep, Period> max_skip_duration)
+        : max_skip_duration_{std::chrono::duration_cast<log_clock::duration>(max_skip_duration)}
+    {
+    }
+
+    // report the last run of skipped messages, if any
+    ~dup_filter_sink() override
+    {
+        try
+        {
+            std::lock_guard<Mutex> lock(base_sink<Mutex>::mutex_);
+            report_skipped_();
+        }
+        catch (...)
+        {
+        }
+    }
+
+protected:
+    void sink_it_(const details::log_msg &msg) override
+    {
+        const auto now = time_of_(msg);
+        if (is_repeat_(msg) && now - last_time_ < max_skip_duration_)
+        {
+            ++skipped_;
+            return;
+        }
+        report_skipped_();
+        dist_sink<Mutex>::sink_it_(msg);
+
+        // remember the message, to filter its repeats
+        last_level_ = msg.level;
+        last_payload_.assign(msg.payload.data(), msg.payload.size());
+        last_logger_name_ = msg.logger_name != nullptr ? *msg.logger_name : std::string();
+        last_source_ = msg.source;
+        last_time_ = now;
+        has_last_ = true;
+    }
+
+    void flush_() override
+    {
+        if (skipped_ > 0 && log_clock::now() - last_time_ >= max_skip_duration_)
+        {
+            report_skipped_(); // the run is over
+        }
+        dist_sink<Mutex>::flush_();
+    }
+
+private:
+    static log_clock::time_point time_of_(const details::log_msg &msg)
+    {
+#ifndef SPDLOG_NO_DATETIME
+        return msg.time;
+#else
+        (void)msg;
+        return log_clock::now();
+#endif
+    }
+
+    bool is_repeat_(const details::log_msg &msg) const
+    {
+        return has_last_ && msg.level == last_level_ && msg.payload.size() == last_payload_.size() &&
+               std::memcmp(msg.payload.data(), last_payload_.data(), last_payload_.size()) == 0;
+    }
+
+    // write the "last message repeated N times" message if messages were skipped
+    void report_skipped_()
+    {
+        if (skipped_ == 0)
+        {
+            return;
+        }
+        details::scoped_format_buffer scoped_buf;
+        fmt::memory_buffer &buf = scoped_buf.get();
+        fmt::format_to(buf, "last message repeated {} times", skipped_);
+        skipped_ = 0;
+        details::log_msg report(last_source_, &last_logger_name_, last_level_, details::fmt_helper::to_string_view(buf));
+        dist_sink<Mutex>::sink_it_(report);
+    }
+
+    const log_clock::duration max_skip_duration_;
+    bool has_last_ = false;
+    level::level_enum last_level_ = level::off;
+    std::string last_payload_;
+    std::string last_logger_name_;
+    source_loc last_source_;
+    log_clock::time_point last_time_;
+    size_t skipped_ = 0;
+};
+
+using dup_filter_sink_mt = dup_filter_sink<std::mutex>;
+using dup_filter_sink_st = dup_filter_sink<details::null_mutex>;
+
+} // namespace sinks
+} // namespace spdlog
@@ -34,7 +34,8 @@ protected:
     void sink_it_(const details::log_msg &msg) override
     {
 
-        fmt::memory_buffer formatted;
+        details::scoped_format_buffer scoped_buf;
+        fmt::memory_buffer &formatted = scoped_buf.get();
         sink::formatter_->format(msg, formatted);
         OutputDebugStringA(fmt::to_string(formatted).c_str());
     }
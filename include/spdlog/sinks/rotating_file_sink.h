@@ -58,10 +58,16 @@ public:
         return fmt::to_string(w);
     }
 
+    int native_fd() const override
+    {
+        return file_helper_.native_fd();
+    }
+
 protected:
     void sink_it_(const details::log_msg &msg) override
     {
-        fmt::memory_buffer formatted;
+        details::scoped_format_buffer scoped_buf;
+        fmt::memory_buffer &formatted = scoped_buf.get();
         sink::formatter_->format(msg, formatted);
         current_size_ += formatted.size();
         if (current_size_ > max_size_)
@@ -5,10 +5,13 @@
 
 #pragma once
 
+#include "spdlog/details/format_buffer.h"
 #include "spdlog/details/log_msg.h"
 #include "spdlog/details/pattern_formatter.h"
 #include "spdlog/formatter.h"
 
+#include <mutex>
+
 namespace spdlog {
 namespace sinks {
 class sink
@@ -47,12 +50,71 @@ public:
         return static_cast<spdlog::level::level_enum>(level_.load(std::memory_order_relaxed));
     }
 
+    // file descriptor the sink writes to, or -1 if none.
+    // read by details::crash_handler from a signal handler - must not lock or allocate.
+    virtual int native_fd() const
+    {
+        return -1;
+    }
+
+    // false if the sink must not be called from several threads (e.g. a *_st sink)
+    virtual bool thread_safe() const
+    {
+        return true;
+    }
+
+    // claim the sink that isn't thread safe for a single consumer: the threads calling
+    // synchronous loggers (sync_consumer()), or one worker thread of async loggers
+    // (see logger::claim_sinks_()).
+    // can be claimed any number of times by the same consumer - return false if it
+    // is claimed by another one.
+    // Note: the sink's own setters (set_pattern(), ...) must not be called meanwhile -
+    // set the formatter through its loggers.
+    bool claim_consumer(const void *consumer)
+    {
+        std::lock_guard<std::mutex> lock(consumer_mutex_());
+        if (consumer_ != nullptr && consumer_ != consumer)
+        {
+            return false;
+        }
+        consumer_ = consumer;
+        ++consumer_claims_;
+        return true;
+    }
+
+    void release_consumer(const void *consumer)
+    {
+        std::lock_guard<std::mutex> lock(consumer_mutex_());
+        if (consumer_ == consumer && --consumer_claims_ == 0)
+        {
+            consumer_ = nullptr;
+        }
+    }
+
+    // the consumer of the sinks of synchronous loggers
+    static const void *sync_consumer()
+    {
+        static const char consumer = 0;
+        return &consumer;
+    }
+
 protected:
     // sink log level - default is all
     level_t level_;
 
     // sink formatter - default is full format
     std::unique_ptr<spdlog::formatter> formatter_;
+
+private:
+    // claims are rare (async logger creation) - one mutex for all the sinks
+    static std::mutex &consumer_mutex_()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    const void *consumer_{nullptr};
+    size_t consumer_claims_{0};
 };
 
 } // namespace sinks
@@ -15,6 +15,7 @@
 #include <cstdio>
 #include <memory>
 #include <mutex>
+#include <type_traits>
 
 namespace spdlog {
 
@@ -35,10 +36,16 @@ public:
     stdout_sink(const stdout_sink &other) = delete;
     stdout_sink &operator=(const stdout_sink &other) = delete;
 
+    bool thread_safe() const override
+    {
+        return !std::is_same<mutex_t, details::null_mutex>::value;
+    }
+
     void log(const details::log_msg &msg) override
     {
         std::lock_guard<mutex_t> lock(mutex_);
-        fmt::memory_buffer formatted;
+        details::scoped_format_buffer scoped_buf;
+        fmt::memory_buffer &formatted = scoped_buf.get();
         formatter_->format(msg, formatted);
         fwrite(formatted.data(), sizeof(char), formatted.size(), file_);
         fflush(TargetStream::stream());
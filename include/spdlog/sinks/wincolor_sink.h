@@ -17,6 +17,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <wincon.h>
 
@@ -58,6 +59,11 @@ public:
     wincolor_sink(const wincolor_sink &other) = delete;
     wincolor_sink &operator=(const wincolor_sink &other) = delete;
 
+    bool thread_safe() const override
+    {
+        return !std::is_same<mutex_t, details::null_mutex>::value;
+    }
+
     // change the color for the given level
     void set_color(level::level_enum level, WORD color)
     {
@@ -68,7 +74,8 @@ public:
     void log(const details::log_msg &msg) final override
     {
         std::lock_guard<mutex_t> lock(mutex_);
-        fmt::memory_buffer formatted;
+        details::scoped_format_buffer scoped_buf;
+        fmt::memory_buffer &formatted = scoped_buf.get();
         formatter_->format(msg, formatted);
         if (msg.color_range_end > msg.color_range_start)
         {
@@ -10,6 +10,7 @@
 #pragma once
 
 #include "spdlog/common.h"
+#include "spdlog/details/call_site_limiter.h"
 #include "spdlog/details/registry.h"
 #include "spdlog/logger.h"
 #include "spdlog/version.h"
@@ -119,7 +120,8 @@ inline void drop_all()
     details::registry::instance().drop_all();
 }
 
-// stop any running threads started by spdlog and clean registry loggers
+// stop any running threads started by spdlog and clean registry loggers.
+// the thread pool of the async loggers stops once the ones still in use are released.
 inline void shutdown()
 {
     details::registry::instance().shutdown();
@@ -310,11 +312,89 @@ inline void critical(const wchar_t *fmt, const Args &... args)
 // SPDLOG_LEVEL_CRITICAL,
 // SPDLOG_LEVEL_OFF
 //
+// the arguments of these macros are only evaluated if the logger's level is enabled.
+//
 
 #define SPDLOG_LOGGER_CALL(logger, level, ...)                                                                                             \
     if (logger->should_log(level))                                                                                                         \
     logger->log(spdlog::source_loc{SPDLOG_FILE_BASENAME(__FILE__), __LINE__, SPDLOG_FUNCTION}, level, __VA_ARGS__)
 
+//
+// log categories with their own compile time level, whatever SPDLOG_ACTIVE_LEVEL is
+// (e.g. keep the debug logs of one subsystem in a release build, or compile out the
+// trace logs of a noisy one):
+//
+//   SPDLOG_DECLARE_CATEGORY(net, SPDLOG_LEVEL_WARN); // at namespace scope
+//   SPDLOG_CAT_DEBUG(net, logger, "sent {} bytes", n); // compiled out
+//   SPDLOG_CAT_WARN(net, logger, "peer {} reset", peer);
+//
+// the calls below the category's level are discarded by the compiler, and their
+// arguments are never evaluated.
+//
+
+#define SPDLOG_DECLARE_CATEGORY(category, active_level)                                                                                    \
+    struct spdlog_category_##category                                                                                                      \
+    {                                                                                                                                      \
+        static const int compiled_level = active_level;                                                                                    \
+    }
+
+#define SPDLOG_CATEGORY_CALL(category, logger, level, ...)                                                                                 \
+    if (spdlog_category_##category::compiled_level <= static_cast<int>(level) && logger->should_log(level))                                \
+    logger->log(spdlog::source_loc{SPDLOG_FILE_BASENAME(__FILE__), __LINE__, SPDLOG_FUNCTION}, level, __VA_ARGS__)
+
+#define SPDLOG_CAT_TRACE(category, logger, ...) SPDLOG_CATEGORY_CALL(category, logger, spdlog::level::trace, __VA_ARGS__)
+#define SPDLOG_CAT_DEBUG(category, logger, ...) SPDLOG_CATEGORY_CALL(category, logger, spdlog::level::debug, __VA_ARGS__)
+#define SPDLOG_CAT_INFO(category, logger, ...) SPDLOG_CATEGORY_CALL(category, logger, spdlog::level::info, __VA_ARGS__)
+#define SPDLOG_CAT_WARN(category, logger, ...) SPDLOG_CATEGORY_CALL(category, logger, spdlog::level::warn, __VA_ARGS__)
+#define SPDLOG_CAT_ERROR(category, logger, ...) SPDLOG_CATEGORY_CALL(category, logger, spdlog::level::err, __VA_ARGS__)
+#define SPDLOG_CAT_CRITICAL(category, logger, ...) SPDLOG_CATEGORY_CALL(category, logger, spdlog::level::critical, __VA_ARGS__)
+
+//
+// rate limited and sampled log calls - e.g. for an error path in a hot loop:
+//
+//   SPDLOG_LOGGER_EVERY_N(logger, spdlog::level::err, 1000, "read failed: {}", err);
+//   SPDLOG_LOGGER_EVERY_INTERVAL(logger, spdlog::level::warn, std::chrono::seconds(1), "queue full");
+//   SPDLOG_LOGGER_RATE_LIMITED(logger, spdlog::level::info, 10, 20, "request {}", id); // 10/s, bursts of 20
+//   SPDLOG_LOGGER_SAMPLED(logger, spdlog::level::debug, 0.01, "packet {}", seq); // ~1%
+//
+// each call site keeps its own state (see details/call_site_limiter.h), and logs the
+// number of msgs it suppressed before the next msg it lets through, and on
+// spdlog::flush_every()'s periodic flush. every_n counts the calls of each thread.
+// the call site is bound to the logger (by name and level) of its first enabled call.
+// levels below SPDLOG_ACTIVE_LEVEL are compiled out as with the macros above.
+//
+
+#define SPDLOG_LOGGER_CALL_LIMITED_(logger, level, check, ...)                                                                             \
+    do                                                                                                                                     \
+    {                                                                                                                                      \
+        if (static_cast<int>(level) >= SPDLOG_ACTIVE_LEVEL && (logger)->should_log(level))                                                 \
+        {                                                                                                                                  \
+            static spdlog::details::call_site_limiter spdlog_call_site_limiter(                                                            \
+                (logger)->name(), level, spdlog::source_loc{SPDLOG_FILE_BASENAME(__FILE__), __LINE__, SPDLOG_FUNCTION});                   \
+            SPDLOG_CALL_SITE_SLOT_STORAGE_ spdlog::details::call_site_limiter::thread_slot spdlog_call_site_slot(                          \
+                spdlog_call_site_limiter);                                                                                                 \
+            if (spdlog_call_site_limiter.check)                                                                                            \
+            {                                                                                                                              \
+                spdlog_call_site_limiter.log(*(logger), __VA_ARGS__);                                                                      \
+            }                                                                                                                              \
+        }                                                                                                                                  \
+    } while (0)
+
+#define SPDLOG_LOGGER_EVERY_N(logger, level, n, ...)                                                                                       \
+    SPDLOG_LOGGER_CALL_LIMITED_(logger, level, every_n(spdlog_call_site_slot, n), __VA_ARGS__)
+#define SPDLOG_LOGGER_EVERY_INTERVAL(logger, level, interval, ...)                                                                         \
+    SPDLOG_LOGGER_CALL_LIMITED_(logger, level, every_interval(spdlog_call_site_slot, interval), __VA_ARGS__)
+#define SPDLOG_LOGGER_RATE_LIMITED(logger, level, per_second, burst, ...)                                                                  \
+    SPDLOG_LOGGER_CALL_LIMITED_(logger, level, token_bucket(spdlog_call_site_slot, per_second, burst), __VA_ARGS__)
+#define SPDLOG_LOGGER_SAMPLED(logger, level, probability, ...)                                                                             \
+    SPDLOG_LOGGER_CALL_LIMITED_(logger, level, sample(spdlog_call_site_slot, probability), __VA_ARGS__)
+
+#define SPDLOG_EVERY_N(level, n, ...) SPDLOG_LOGGER_EVERY_N(spdlog::default_logger_raw(), level, n, __VA_ARGS__)
+#define SPDLOG_EVERY_INTERVAL(level, interval, ...) SPDLOG_LOGGER_EVERY_INTERVAL(spdlog::default_logger_raw(), level, interval, __VA_ARGS__)
+#define SPDLOG_RATE_LIMITED(level, per_second, burst, ...)                                                                                 \
+    SPDLOG_LOGGER_RATE_LIMITED(spdlog::default_logger_raw(), level, per_second, burst, __VA_ARGS__)
+#define SPDLOG_SAMPLED(level, probability, ...) SPDLOG_LOGGER_SAMPLED(spdlog::default_logger_raw(), level, probability, __VA_ARGS__)
+
 #if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_TRACE
 #define SPDLOG_LOGGER_TRACE(logger, ...) SPDLOG_LOGGER_CALL(logger, spdlog::level::trace, __VA_ARGS__)
 #define SPDLOG_TRACE(...) SPDLOG_LOGGER_TRACE(spdlog::default_logger_raw(), __VA_ARGS__)
@@ -21,6 +21,16 @@
 // #define SPDLOG_CLOCK_COARSE
 ///////////////////////////////////////////////////////////////////////////////
 
+///////////////////////////////////////////////////////////////////////////////
+// Uncomment to time the log messages with the cpu's timestamp counter, calibrated
+// against the system clock every second by a background thread.
+// Keeps a sub microsecond resolution for a fraction of the cost of the
+// regular clock (see details/tsc_clock.h). x86 and aarch64 only (falls back to
+// the regular clock elsewhere, and on cpus without an invariant counter).
+//
+// #define SPDLOG_CLOCK_TSC
+///////////////////////////////////////////////////////////////////////////////
+
 ///////////////////////////////////////////////////////////////////////////////
 // Uncomment if date/time logging is not needed and never appear in the log
 // pattern.
@@ -53,6 +63,14 @@
 // #define SPDLOG_NO_TLS
 ///////////////////////////////////////////////////////////////////////////////
 
+///////////////////////////////////////////////////////////////////////////////
+// Uncomment to change the size above which a thread's reusable format buffer
+// is released after a log call (instead of kept for the next ones).
+// see details/format_buffer.h
+//
+// #define SPDLOG_FORMAT_BUFFER_MAX_RETAINED (64 * 1024)
+///////////////////////////////////////////////////////////////////////////////
+
 ///////////////////////////////////////////////////////////////////////////////
 // Uncomment if logger name logging is not needed.
 // This will prevent spdlog from copying the logger name on each log call.
@@ -114,6 +132,84 @@
 // #define SPDLOG_ENABLE_MESSAGE_COUNTER
 ///////////////////////////////////////////////////////////////////////////////
 
+///////////////////////////////////////////////////////////////////////////////
+// Uncomment to back the async thread pool with a lock-free bounded ring buffer
+// instead of the mutex protected queue.
+// Producers never take a lock, the worker threads park only when the queue is
+// empty. Capacity is rounded up to the next power of 2.
+//
+// #define SPDLOG_ASYNC_LOCKFREE_QUEUE
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Uncomment to give each logging thread its own single producer ring buffer
+// in the async thread pool (registered lazily in thread local storage).
+// The single worker thread merges the lanes by message time, so producers
+// never contend with each other.
+// The queue size passed to the thread pool is the capacity of each lane, up to
+// SPDLOG_ASYNC_LANE_MAX_ITEMS (default 1024) since each lane is allocated upfront,
+// and the thread pool must have exactly one worker thread.
+//
+// #define SPDLOG_ASYNC_SPSC_LANES
+// #define SPDLOG_ASYNC_LANE_MAX_ITEMS 1024
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Uncomment to store the messages of the (mutex protected) async queue in a
+// byte ring of variable length records - header and payload written inline at
+// their exact size - instead of fixed size pre-constructed async_msg slots.
+// Payloads up to SPDLOG_ASYNC_SLAB_MAX_PAYLOAD bytes (default 512) never
+// allocate. The queue size passed to the thread pool sizes the ring for that
+// many messages of 64 bytes payload.
+//
+// #define SPDLOG_ASYNC_SLAB_QUEUE
+// #define SPDLOG_ASYNC_SLAB_MAX_PAYLOAD 512
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Uncomment to split the (mutex protected) async queue in severity lanes:
+// err/critical, info/warn and trace/debug. The worker threads always take
+// the most severe messages first, and a full queue overruns the least severe
+// ones first (async_overflow_policy::overrun_oldest).
+// Note: messages of different lanes are no longer written in the order they
+// were logged. The lanes share the queue's memory: up to 1.5 times that of
+// the regular queue, as a lane grows into the room the others don't use.
+//
+// #define SPDLOG_ASYNC_PRIORITY_QUEUE
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Uncomment to let async loggers format on the worker thread.
+// Log calls with a SPDLOG_FMT format string (c++14) and args that are all
+// arithmetic or enum values (see spdlog::is_deferrable_arg) only copy the args
+// and the format string address to the queue. Other calls are still formatted
+// by the caller.
+//
+// #define SPDLOG_ASYNC_DEFERRED_FORMATTING
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Uncomment to change the max number of messages an async worker thread pops
+// from the queue at once (default is 64).
+// The flush policy of the loggers is applied once per batch.
+//
+// #define SPDLOG_ASYNC_BATCH_SIZE 64
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Uncomment to compile in thread_pool_options::crash_dump (dump of the queued
+// messages on fatal signals, posix only).
+//
+// #define SPDLOG_ASYNC_CRASH_DUMP
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Uncomment to compile in thread_pool_options::shm_journal and
+// spdlog::recover_async_journal() (posix only, link with -lrt on older glibc).
+//
+// #define SPDLOG_ASYNC_SHM_JOURNAL
+///////////////////////////////////////////////////////////////////////////////
+
 ///////////////////////////////////////////////////////////////////////////////
 // Uncomment to customize level names (e.g. "MT TRACE")
 //
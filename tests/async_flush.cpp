@@ -0,0 +1,140 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "spdlog/spdlog.h"
+#include "spdlog/async.h"
+
+#include "test_sink.h"
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace spdlogTests
+{
+	TEST_CLASS(async_flush_Tests)
+	{
+	public:
+		TEST_METHOD(flush_async_flushes_after_the_logged_msgs)
+		{
+			auto tp = std::make_shared<spdlog::details::thread_pool>(64, 1);
+			auto sink = std::make_shared<test_sink>();
+			spdlog::async_logger logger("flush_async", sink, tp);
+			for (int i = 0; i < 1000; i++)
+			{
+				logger.info("msg {}", i);
+			}
+			logger.flush_async().get();
+
+			Assert::AreEqual(size_t(1), sink->flush_count());
+			Assert::AreEqual(size_t(1000), sink->count_at_last_flush());
+		}
+
+		TEST_METHOD(flush_async_waits_for_the_worker)
+		{
+			auto tp = std::make_shared<spdlog::details::thread_pool>(64, 1);
+			auto sink = std::make_shared<test_sink>();
+			spdlog::async_logger logger("flush_wait", sink, tp);
+			sink->close_gate();
+			logger.info("held");
+			sink->wait_at_gate();
+			logger.info("queued");
+
+			auto flushed = logger.flush_async();
+			Assert::IsTrue(flushed.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout);
+			Assert::IsFalse(logger.flush_and_wait(std::chrono::milliseconds(10)));
+			sink->open_gate();
+			flushed.get();
+			Assert::AreEqual(size_t(2), sink->count_at_last_flush());
+			Assert::IsTrue(logger.flush_and_wait(std::chrono::seconds(10)));
+		}
+
+#ifndef SPDLOG_ASYNC_SPSC_LANES // a single worker per queue
+		TEST_METHOD(flush_barrier_waits_for_every_worker)
+		{
+			// with several workers sharing the queue, the msgs logged before the flush
+			// may be in the batch of any of them
+			auto tp = std::make_shared<spdlog::details::thread_pool>(64, 3);
+			auto sink = std::make_shared<test_sink>();
+			spdlog::async_logger logger("flush_workers", sink, tp);
+			std::vector<std::thread> threads;
+			for (int t = 0; t < 4; t++)
+			{
+				threads.emplace_back([&logger] {
+					for (int i = 0; i < 2000; i++)
+					{
+						logger.info("msg {}", i);
+					}
+				});
+			}
+			for (auto &t : threads)
+			{
+				t.join();
+			}
+			Assert::IsTrue(logger.flush_and_wait(std::chrono::seconds(10)));
+			Assert::AreEqual(size_t(8000), sink->count_at_last_flush());
+		}
+
+		TEST_METHOD(drain_waits_for_every_worker)
+		{
+			auto tp = std::make_shared<spdlog::details::thread_pool>(64, 3);
+			auto sink = std::make_shared<test_sink>();
+			spdlog::async_logger logger("drain_workers", sink, tp);
+			for (int i = 0; i < 5000; i++)
+			{
+				logger.info("msg {}", i);
+			}
+			tp->drain();
+			Assert::AreEqual(size_t(5000), sink->count());
+		}
+#endif
+
+		TEST_METHOD(destruction_waits_for_the_logger_queue_only)
+		{
+			spdlog::thread_pool_options options;
+			options.sharded = true;
+			auto tp = std::make_shared<spdlog::details::thread_pool>(64, 2, options);
+			auto held_sink = std::make_shared<test_sink>();
+			spdlog::async_logger held("held", held_sink, tp);
+			held_sink->close_gate();
+			held.info("held");
+			held_sink->wait_at_gate();
+
+			// a logger of the other worker's queue
+			const std::hash<std::string> shard_hash;
+			std::string name = "other";
+			while (shard_hash(name) % 2 == shard_hash("held") % 2)
+			{
+				name += "_";
+			}
+			auto sink = std::make_shared<test_sink>();
+			auto destroyed = std::async(std::launch::async, [&] {
+				spdlog::async_logger other(name, sink, tp);
+				other.info("msg");
+			});
+			const bool done = destroyed.wait_for(std::chrono::seconds(10)) == std::future_status::ready;
+			held_sink->open_gate();
+			Assert::IsTrue(done);
+			Assert::AreEqual(size_t(1), sink->count());
+		}
+
+		TEST_METHOD(flush_async_fails_after_shutdown)
+		{
+			auto tp = std::make_shared<spdlog::details::thread_pool>(64, 1);
+			auto sink = std::make_shared<test_sink>();
+			spdlog::async_logger logger("flush_shutdown", sink, tp);
+			logger.info("before shutdown");
+			tp->shutdown(std::chrono::seconds(10));
+			Assert::AreEqual(size_t(1), sink->count());
+
+			auto flushed = logger.flush_async();
+			Assert::ExpectException<spdlog::spdlog_ex>([&flushed] { flushed.get(); });
+		}
+	};
+}
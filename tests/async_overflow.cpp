@@ -0,0 +1,97 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "spdlog/spdlog.h"
+#include "spdlog/async.h"
+
+#include "test_sink.h"
+
+#include <cstdint>
+#include <memory>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace spdlogTests
+{
+	TEST_CLASS(async_overflow_Tests)
+	{
+	public:
+		// in each test the worker thread waits in the sink for the first msg, while
+		// four times the queue capacity is logged behind it
+
+		TEST_METHOD(discard_new_counts_the_dropped_msgs)
+		{
+			auto tp = std::make_shared<spdlog::details::thread_pool>(16, 1);
+			auto sink = std::make_shared<test_sink>();
+			spdlog::async_logger logger("discard_new", sink, tp, spdlog::async_overflow_policy::discard_new);
+			const size_t logged = 4 * tp->queue_capacity();
+			hold_worker(logger, *sink);
+			for (size_t i = 0; i < logged; i++)
+			{
+				logger.info("msg {}", i);
+			}
+			sink->open_gate();
+			tp->drain();
+
+			Assert::IsTrue(logger.dropped_count() > 0);
+			Assert::AreEqual(logged + 1, sink->count() + logger.dropped_count());
+			Assert::AreEqual(size_t(0), tp->overrun_counter());
+		}
+
+		TEST_METHOD(try_log_reports_the_dropped_msgs)
+		{
+			auto tp = std::make_shared<spdlog::details::thread_pool>(16, 1);
+			auto sink = std::make_shared<test_sink>();
+			spdlog::async_logger logger("try_log", sink, tp); // blocking policy, but try_log() never blocks
+			const size_t logged = 4 * tp->queue_capacity();
+			hold_worker(logger, *sink);
+			size_t rejected = 0;
+			for (size_t i = 0; i < logged; i++)
+			{
+				if (!logger.try_log(spdlog::level::info, "msg {}", i))
+				{
+					rejected++;
+				}
+			}
+			sink->open_gate();
+			tp->drain();
+
+			Assert::IsTrue(rejected > 0);
+			Assert::AreEqual(rejected, logger.dropped_count());
+			Assert::AreEqual(logged + 1 - rejected, sink->count());
+		}
+
+		TEST_METHOD(overrun_oldest_counts_the_overrun_msgs)
+		{
+			auto tp = std::make_shared<spdlog::details::thread_pool>(16, 1);
+			auto sink = std::make_shared<test_sink>();
+			spdlog::async_logger logger("overrun_oldest", sink, tp, spdlog::async_overflow_policy::overrun_oldest);
+			const size_t logged = 4 * tp->queue_capacity();
+			hold_worker(logger, *sink);
+			for (size_t i = 0; i < logged; i++)
+			{
+				logger.info("msg {}", i);
+			}
+			sink->open_gate();
+			tp->drain();
+
+			const size_t overrun = tp->overrun_counter();
+			Assert::IsTrue(overrun > 0);
+			Assert::AreEqual(logged + 1, sink->count() + overrun);
+			Assert::AreEqual(size_t(0), logger.dropped_count());
+
+			auto stats = tp->stats();
+			Assert::AreEqual(overrun, static_cast<size_t>(stats.overrun));
+			Assert::AreEqual(static_cast<uint64_t>(sink->count()), stats.written);
+		}
+
+	private:
+		// log a first msg, and wait until the worker thread is stuck in the sink with it
+		static void hold_worker(spdlog::logger &logger, test_sink &sink)
+		{
+			sink.close_gate();
+			logger.info("first");
+			sink.wait_at_gate();
+		}
+	};
+}
@@ -0,0 +1,210 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "spdlog/spdlog.h"
+#include "spdlog/async.h"
+#include "spdlog/details/mpmc_blocking_q.h"
+#include "spdlog/details/mpmc_lockfree_q.h"
+#include "spdlog/details/priority_q.h"
+#include "spdlog/details/slab_q.h"
+#ifndef SPDLOG_NO_TLS
+#include "spdlog/details/spsc_lanes_q.h"
+#endif
+
+#include "test_sink.h"
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace spdlogTests
+{
+	TEST_CLASS(async_queues_Tests)
+	{
+	public:
+		// each queue engine, fed by several producers through a queue small enough to block them
+
+		TEST_METHOD(blocking_queue_keeps_producer_order)
+		{
+			spdlog::details::mpmc_blocking_queue<spdlog::details::async_msg> q(64);
+			check_producer_order(q);
+		}
+
+		TEST_METHOD(lockfree_queue_keeps_producer_order)
+		{
+			spdlog::details::mpmc_lockfree_queue<spdlog::details::async_msg> q(64);
+			check_producer_order(q);
+		}
+
+#ifndef SPDLOG_NO_TLS
+		TEST_METHOD(spsc_lanes_queue_keeps_producer_order)
+		{
+			spdlog::details::spsc_lanes_queue<spdlog::details::async_msg> q(64);
+			check_producer_order(q);
+		}
+#endif
+
+		TEST_METHOD(slab_queue_keeps_producer_order)
+		{
+			using slab = spdlog::details::slab_q<spdlog::details::async_msg>;
+			spdlog::details::mpmc_blocking_queue<spdlog::details::async_msg, slab> q(64);
+			check_producer_order(q);
+		}
+
+		TEST_METHOD(priority_queue_keeps_producer_order)
+		{
+			// each producer logs at its own level, so each lane gets its own producers
+			using priority = spdlog::details::priority_q<spdlog::details::async_msg>;
+			spdlog::details::mpmc_blocking_queue<spdlog::details::async_msg, priority> q(64);
+			check_producer_order(q);
+		}
+
+		TEST_METHOD(priority_queue_pops_severe_msgs_first)
+		{
+			spdlog::details::priority_q<spdlog::details::async_msg> q(16);
+			q.push_back(make_msg(spdlog::level::trace, 0, 0));
+			q.push_back(make_msg(spdlog::level::info, 0, 1));
+			q.push_back(make_msg(spdlog::level::err, 0, 2));
+			q.push_back(make_msg(spdlog::level::trace, 0, 3));
+
+			spdlog::details::async_msg popped;
+			q.pop_front(popped);
+			Assert::AreEqual(size_t(2), popped.msg_id);
+			q.pop_front(popped);
+			Assert::AreEqual(size_t(1), popped.msg_id);
+			q.pop_front(popped);
+			Assert::AreEqual(size_t(0), popped.msg_id);
+			q.pop_front(popped);
+			Assert::AreEqual(size_t(3), popped.msg_id);
+			Assert::IsTrue(q.empty());
+		}
+
+		// the engine the thread pool is compiled with, through async loggers
+
+		TEST_METHOD(drain_writes_the_msgs_in_order)
+		{
+			auto tp = std::make_shared<spdlog::details::thread_pool>(64, 1);
+			auto sink = std::make_shared<test_sink>();
+			auto logger = std::make_shared<spdlog::async_logger>("drain", sink, tp);
+			log_from_threads(*logger);
+			tp->drain();
+			check_lines(sink->lines());
+		}
+
+		TEST_METHOD(destroyed_logger_writes_its_msgs)
+		{
+			auto tp = std::make_shared<spdlog::details::thread_pool>(64, 1);
+			auto sink = std::make_shared<test_sink>();
+			auto logger = std::make_shared<spdlog::async_logger>("destroy", sink, tp);
+			log_from_threads(*logger);
+			tp.reset(); // the logger keeps the thread pool alive
+			logger.reset();
+			check_lines(sink->lines());
+		}
+
+		TEST_METHOD(sharded_pool_keeps_each_logger_order)
+		{
+			spdlog::thread_pool_options options;
+			options.sharded = true;
+			auto tp = std::make_shared<spdlog::details::thread_pool>(64, 2, options);
+			auto sink1 = std::make_shared<test_sink>();
+			auto sink2 = std::make_shared<test_sink>();
+			auto logger1 = std::make_shared<spdlog::async_logger>("shard1", sink1, tp);
+			auto logger2 = std::make_shared<spdlog::async_logger>("shard2", sink2, tp);
+			std::thread other([&logger2] { log_from_threads(*logger2); });
+			log_from_threads(*logger1);
+			other.join();
+			logger1.reset();
+			logger2.reset();
+			check_lines(sink1->lines());
+			check_lines(sink2->lines());
+		}
+
+	private:
+		static const size_t producers = 4;
+		static const size_t msgs_per_producer = 5000;
+
+		static spdlog::details::async_msg make_msg(spdlog::level::level_enum lvl, size_t producer, size_t seq)
+		{
+			spdlog::details::async_msg msg(spdlog::details::async_msg_type::log);
+			msg.level = lvl;
+			msg.time = spdlog::log_clock::now();
+			msg.thread_id = producer;
+			msg.msg_id = seq;
+			return msg;
+		}
+
+		// every msg is dequeued once, and the msgs of each producer in the order they were enqueued
+		template<typename Q>
+		static void check_producer_order(Q &q)
+		{
+			std::vector<std::thread> threads;
+			for (size_t p = 0; p < producers; p++)
+			{
+				threads.emplace_back([&q, p] {
+					const auto lvl = static_cast<spdlog::level::level_enum>(p % spdlog::level::off);
+					for (size_t i = 0; i < msgs_per_producer; i++)
+					{
+						q.enqueue(make_msg(lvl, p, i));
+					}
+				});
+			}
+
+			std::vector<size_t> next(producers, 0);
+			size_t received = 0;
+			spdlog::details::async_msg popped;
+			while (received < producers * msgs_per_producer && q.dequeue_for(popped, std::chrono::seconds(10)))
+			{
+				Assert::IsTrue(popped.thread_id < producers);
+				Assert::AreEqual(next[popped.thread_id], popped.msg_id);
+				next[popped.thread_id]++;
+				received++;
+			}
+			for (auto &t : threads)
+			{
+				t.join();
+			}
+			Assert::AreEqual(producers * msgs_per_producer, received);
+			Assert::AreEqual(size_t(0), q.overrun_counter());
+		}
+
+		// log "<producer> <seq>" msgs from several threads
+		static void log_from_threads(spdlog::logger &logger)
+		{
+			std::vector<std::thread> threads;
+			for (size_t p = 0; p < producers; p++)
+			{
+				threads.emplace_back([&logger, p] {
+					for (size_t i = 0; i < msgs_per_producer; i++)
+					{
+						logger.info("{} {}", p, i);
+					}
+				});
+			}
+			for (auto &t : threads)
+			{
+				t.join();
+			}
+		}
+
+		// every msg of log_from_threads() is written, the msgs of each thread in order
+		static void check_lines(const std::vector<std::string> &lines)
+		{
+			Assert::AreEqual(producers * msgs_per_producer, lines.size());
+			std::vector<size_t> next(producers, 0);
+			for (auto &line : lines)
+			{
+				char *end = nullptr;
+				const size_t p = std::strtoul(line.c_str(), &end, 10);
+				const size_t seq = std::strtoul(end, nullptr, 10);
+				Assert::IsTrue(p < producers);
+				Assert::AreEqual(next[p], seq);
+				next[p]++;
+			}
+		}
+	};
+}
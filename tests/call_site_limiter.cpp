@@ -0,0 +1,134 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "spdlog/spdlog.h"
+
+#include "test_sink.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace spdlogTests
+{
+	TEST_CLASS(call_site_limiter_Tests)
+	{
+	public:
+		TEST_METHOD(every_n_logs_the_suppressed_count_before_the_next_msg)
+		{
+			auto sink = std::make_shared<test_sink>();
+			auto logger = std::make_shared<spdlog::logger>("every_n", sink);
+			for (int i = 0; i < 7; i++)
+			{
+				SPDLOG_LOGGER_EVERY_N(logger, spdlog::level::info, 3, "msg {}", i);
+			}
+
+			expect_lines(*sink, {"msg 0", "2 similar msgs suppressed", "msg 3", "2 similar msgs suppressed", "msg 6"});
+		}
+
+		TEST_METHOD(every_n_counts_the_calls_of_each_thread)
+		{
+			auto sink = std::make_shared<test_sink>();
+			auto logger = std::make_shared<spdlog::logger>("every_n_threads", sink);
+			spdlog::register_logger(logger);
+			for (int t = 0; t < 2; t++)
+			{
+				// the thread's slot goes away with it, its count stays with the call site
+				std::thread([&logger] {
+					for (int i = 0; i < 4; i++)
+					{
+						SPDLOG_LOGGER_EVERY_N(logger, spdlog::level::info, 2, "msg");
+					}
+				}).join();
+			}
+			spdlog::details::registry::instance().flush_all();
+			spdlog::drop("every_n_threads");
+
+			size_t msgs = 0, suppressed = 0;
+			for (const auto &line : sink->lines())
+			{
+				if (line == "msg")
+				{
+					msgs++;
+				}
+				else
+				{
+					suppressed += std::stoul(line);
+				}
+			}
+			Assert::AreEqual(size_t(4), msgs);
+			Assert::AreEqual(size_t(4), suppressed);
+		}
+
+		TEST_METHOD(token_bucket_lets_a_burst_through_then_refills)
+		{
+			spdlog::details::call_site_limiter limiter("bucket", spdlog::level::info, spdlog::source_loc{});
+			spdlog::details::call_site_limiter::thread_slot slot(limiter);
+			Assert::AreEqual(5, passed(10, [&] { return limiter.token_bucket(slot, 20, 5); }));
+			Assert::AreEqual(uint64_t(5), limiter.suppressed());
+
+			// 4 tokens at 20/s, more if the sleep is late - but never more than the burst
+			std::this_thread::sleep_for(std::chrono::milliseconds(200));
+			const int refilled = passed(10, [&] { return limiter.token_bucket(slot, 20, 5); });
+			Assert::IsTrue(refilled >= 3 && refilled <= 5);
+		}
+
+		TEST_METHOD(every_interval_lets_one_call_per_interval_through)
+		{
+			spdlog::details::call_site_limiter limiter("interval", spdlog::level::info, spdlog::source_loc{});
+			spdlog::details::call_site_limiter::thread_slot slot(limiter);
+			const auto interval = std::chrono::milliseconds(100);
+			Assert::AreEqual(1, passed(5, [&] { return limiter.every_interval(slot, interval); }));
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(150));
+			Assert::AreEqual(1, passed(5, [&] { return limiter.every_interval(slot, interval); }));
+			Assert::AreEqual(uint64_t(8), limiter.suppressed());
+		}
+
+		TEST_METHOD(flush_all_reports_a_quiet_call_site)
+		{
+			auto sink = std::make_shared<test_sink>();
+			auto logger = std::make_shared<spdlog::logger>("rate_limited", sink);
+			spdlog::register_logger(logger);
+			for (int i = 0; i < 5; i++)
+			{
+				SPDLOG_LOGGER_RATE_LIMITED(logger, spdlog::level::warn, 0.001, 1, "msg {}", i);
+			}
+			expect_lines(*sink, {"msg 0"});
+
+			spdlog::details::registry::instance().flush_all();
+			expect_lines(*sink, {"msg 0", "4 similar msgs suppressed"});
+
+			// reported once
+			spdlog::details::registry::instance().flush_all();
+			spdlog::drop("rate_limited");
+			expect_lines(*sink, {"msg 0", "4 similar msgs suppressed"});
+		}
+
+	private:
+		template<typename Check>
+		static int passed(int calls, Check check)
+		{
+			int passed = 0;
+			for (int i = 0; i < calls; i++)
+			{
+				passed += check() ? 1 : 0;
+			}
+			return passed;
+		}
+
+		static void expect_lines(test_sink &sink, const std::vector<std::string> &expected)
+		{
+			const auto lines = sink.lines();
+			Assert::AreEqual(expected.size(), lines.size());
+			for (size_t i = 0; i < expected.size(); i++)
+			{
+				Assert::AreEqual(expected[i], lines[i]);
+			}
+		}
+	};
+}
@@ -0,0 +1,59 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "spdlog/spdlog.h"
+
+#include "test_sink.h"
+
+#include <memory>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace spdlogTests
+{
+#ifdef SPDLOG_HAS_COMPILED_FORMAT
+	TEST_CLASS(compiled_format_Tests)
+	{
+	public:
+		TEST_METHOD(plain_fields_are_formatted)
+		{
+			auto sink = std::make_shared<test_sink>();
+			spdlog::logger logger("compiled", sink);
+			logger.info(SPDLOG_FMT("{} items in {}ms ({})"), 42, 1.5, std::string("done"));
+			logger.info(SPDLOG_FMT("{:>4}|{:x}"), 7, 255);
+
+			Assert::AreEqual(size_t(2), sink->count());
+			Assert::AreEqual(std::string("42 items in 1.5ms (done)"), sink->lines()[0]);
+			Assert::AreEqual(std::string("   7|ff"), sink->lines()[1]);
+		}
+
+		TEST_METHOD(indexed_fields_are_formatted_by_fmt)
+		{
+			auto sink = std::make_shared<test_sink>();
+			spdlog::logger logger("compiled", sink);
+			logger.info(SPDLOG_FMT("{1} {0}"), "a", "b");
+			logger.info(SPDLOG_FMT("no fields"));
+			logger.info(SPDLOG_FMT("{{{}}}"), 3);
+
+			Assert::AreEqual(size_t(3), sink->count());
+			Assert::AreEqual(std::string("b a"), sink->lines()[0]);
+			Assert::AreEqual(std::string("no fields"), sink->lines()[1]);
+			Assert::AreEqual(std::string("{3}"), sink->lines()[2]);
+		}
+
+		TEST_METHOD(null_string_pointer_is_an_error)
+		{
+			auto sink = std::make_shared<test_sink>();
+			spdlog::logger logger("compiled", sink);
+			std::string error;
+			logger.set_error_handler([&error](const std::string &msg) { error = msg; });
+			const char *null_string = nullptr;
+			logger.info(SPDLOG_FMT("value: {}"), null_string);
+
+			Assert::AreEqual(size_t(0), sink->count());
+			Assert::AreEqual(std::string("string pointer is null"), error);
+		}
+	};
+#endif
+}
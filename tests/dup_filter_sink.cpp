@@ -0,0 +1,118 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "spdlog/spdlog.h"
+#include "spdlog/sinks/dup_filter_sink.h"
+
+#include "test_sink.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace spdlogTests
+{
+	TEST_CLASS(dup_filter_sink_Tests)
+	{
+	public:
+		TEST_METHOD(repeats_are_summarized)
+		{
+			auto sink = std::make_shared<test_sink>();
+			auto dup_filter = std::make_shared<spdlog::sinks::dup_filter_sink_st>(std::chrono::seconds(5));
+			dup_filter->add_sink(sink);
+			spdlog::logger logger("dup_filter", dup_filter);
+			logger.info("Hello");
+			logger.info("Hello");
+			logger.info("Hello");
+			logger.info("Different Hello");
+
+			expect_lines(*sink, {"Hello", "last message repeated 2 times", "Different Hello"});
+		}
+
+		TEST_METHOD(other_levels_are_not_repeats)
+		{
+			auto sink = std::make_shared<test_sink>();
+			auto dup_filter = std::make_shared<spdlog::sinks::dup_filter_sink_st>(std::chrono::seconds(5));
+			dup_filter->add_sink(sink);
+			spdlog::logger logger("dup_filter", dup_filter);
+			logger.info("Hello");
+			logger.warn("Hello");
+			logger.warn("Hello");
+
+			expect_lines(*sink, {"Hello", "Hello"});
+		}
+
+#ifndef SPDLOG_NO_DATETIME // the filter times the msgs by msg.time
+		TEST_METHOD(repeats_are_written_again_after_max_skip_duration)
+		{
+			auto sink = std::make_shared<test_sink>();
+			auto dup_filter = std::make_shared<spdlog::sinks::dup_filter_sink_st>(std::chrono::seconds(5));
+			dup_filter->add_sink(sink);
+			const auto start = spdlog::log_clock::now() - std::chrono::minutes(1);
+			log_at(*dup_filter, start, "Hello");
+			log_at(*dup_filter, start + std::chrono::seconds(1), "Hello");
+			log_at(*dup_filter, start + std::chrono::seconds(2), "Hello");
+			log_at(*dup_filter, start + std::chrono::seconds(10), "Hello");
+			log_at(*dup_filter, start + std::chrono::seconds(11), "Hello");
+
+			expect_lines(*sink, {"Hello", "last message repeated 2 times", "Hello"});
+		}
+
+		TEST_METHOD(flush_reports_a_finished_run)
+		{
+			auto sink = std::make_shared<test_sink>();
+			auto dup_filter = std::make_shared<spdlog::sinks::dup_filter_sink_st>(std::chrono::seconds(5));
+			dup_filter->add_sink(sink);
+			const auto now = spdlog::log_clock::now();
+
+			// the run is still going on
+			log_at(*dup_filter, now, "Hello");
+			log_at(*dup_filter, now, "Hello");
+			dup_filter->flush();
+			expect_lines(*sink, {"Hello"});
+
+			// the run is over
+			log_at(*dup_filter, now - std::chrono::minutes(1), "Bye");
+			log_at(*dup_filter, now - std::chrono::minutes(1), "Bye");
+			dup_filter->flush();
+			expect_lines(*sink, {"Hello", "last message repeated 1 times", "Bye", "last message repeated 1 times"});
+		}
+#endif
+
+		TEST_METHOD(destruction_reports_the_last_run)
+		{
+			auto sink = std::make_shared<test_sink>();
+			{
+				auto dup_filter = std::make_shared<spdlog::sinks::dup_filter_sink_st>(std::chrono::seconds(5));
+				dup_filter->add_sink(sink);
+				spdlog::logger logger("dup_filter", dup_filter);
+				logger.info("Hello");
+				logger.info("Hello");
+				expect_lines(*sink, {"Hello"});
+			}
+			expect_lines(*sink, {"Hello", "last message repeated 1 times"});
+		}
+
+	private:
+		static void log_at(spdlog::sinks::sink &sink, spdlog::log_clock::time_point time, const char *payload)
+		{
+			const std::string logger_name = "dup_filter";
+			spdlog::details::log_msg msg(&logger_name, spdlog::level::info, payload);
+			msg.time = time;
+			sink.log(msg);
+		}
+
+		static void expect_lines(test_sink &sink, const std::vector<std::string> &expected)
+		{
+			const auto lines = sink.lines();
+			Assert::AreEqual(expected.size(), lines.size());
+			for (size_t i = 0; i < expected.size(); i++)
+			{
+				Assert::AreEqual(expected[i], lines[i]);
+			}
+		}
+	};
+}
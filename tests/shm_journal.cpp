@@ -0,0 +1,85 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "spdlog/spdlog.h"
+#include "spdlog/async.h"
+
+#include "test_sink.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace spdlogTests
+{
+#if defined(SPDLOG_ASYNC_SHM_JOURNAL) && !defined(_WIN32)
+	TEST_CLASS(shm_journal_Tests)
+	{
+	public:
+		TEST_METHOD(recover_replays_the_unconsumed_records)
+		{
+			const std::string name = "/spdlog-tests-journal";
+			spdlog::details::shm_journal::recover(name, [](const spdlog::details::log_msg &) {}); // left by a previous run
+
+			const std::string logger_name = "journaled";
+			{
+				spdlog::details::shm_journal journal(name, 8);
+				std::vector<uint64_t> ids;
+				for (auto payload : {"one", "two", "three"})
+				{
+					spdlog::details::log_msg msg(&logger_name, spdlog::level::warn, payload);
+					ids.push_back(journal.append(msg, msg.payload));
+				}
+				journal.consume(ids[1]);
+			} // "crashed": the journal stays
+
+			std::vector<std::string> replayed;
+			const size_t recovered = spdlog::details::shm_journal::recover(name, [&](const spdlog::details::log_msg &msg) {
+				Assert::AreEqual(logger_name, *msg.logger_name);
+				Assert::IsTrue(msg.level == spdlog::level::warn);
+				replayed.emplace_back(msg.payload.data(), msg.payload.size());
+			});
+			Assert::AreEqual(size_t(2), recovered);
+			Assert::AreEqual(std::string("one"), replayed[0]);
+			Assert::AreEqual(std::string("three"), replayed[1]);
+
+			// recover() deleted the journal
+			Assert::AreEqual(size_t(0), spdlog::details::shm_journal::recover(name, [](const spdlog::details::log_msg &) {}));
+		}
+
+		TEST_METHOD(dropped_msgs_are_not_replayed)
+		{
+			const std::string name = "/spdlog-tests-pool-journal";
+			spdlog::details::shm_journal::recover(name, [](const spdlog::details::log_msg &) {});
+
+			spdlog::thread_pool_options options;
+			options.shm_journal = name;
+			auto tp = std::make_shared<spdlog::details::thread_pool>(16, 1, options);
+			auto sink = std::make_shared<test_sink>();
+			spdlog::async_logger logger("journal", sink, tp, spdlog::async_overflow_policy::overrun_oldest);
+
+			// hold the worker thread in the sink, and overrun the queue behind it
+			sink->close_gate();
+			logger.info("first");
+			sink->wait_at_gate();
+			const size_t logged = 4 * tp->queue_capacity();
+			for (size_t i = 0; i < logged; i++)
+			{
+				logger.info("msg {}", i);
+			}
+			Assert::IsTrue(tp->overrun_counter() > 0);
+
+			// a crash now would replay the msg in the sink and the queued ones - not the overrun ones
+			const size_t unwritten = spdlog::details::shm_journal::recover(name, [](const spdlog::details::log_msg &) {}, false);
+			Assert::AreEqual(1 + tp->stats().queue_depth, unwritten);
+
+			sink->open_gate();
+			tp->drain();
+			Assert::AreEqual(logged + 1, sink->count() + tp->overrun_counter());
+			Assert::AreEqual(size_t(0), spdlog::details::shm_journal::recover(name, [](const spdlog::details::log_msg &) {}, false));
+		}
+	};
+#endif
+}
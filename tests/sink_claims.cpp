@@ -0,0 +1,45 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "spdlog/spdlog.h"
+#include "spdlog/async.h"
+#include "spdlog/sinks/null_sink.h"
+
+#include "test_sink.h"
+
+#include <memory>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace spdlogTests
+{
+	TEST_CLASS(sink_claims_Tests)
+	{
+	public:
+		TEST_METHOD(single_threaded_sink_has_one_consumer)
+		{
+			auto st_sink = std::make_shared<spdlog::sinks::null_sink_st>();
+			spdlog::logger sync_logger("sync", st_sink);
+			auto tp = std::make_shared<spdlog::details::thread_pool>(64, 1);
+
+			// fed by the calling threads of sync_logger already
+			Assert::ExpectException<spdlog::spdlog_ex>([&] { spdlog::async_logger rejected("async", st_sink, tp); });
+		}
+
+		TEST_METHOD(add_sink_rejects_a_claimed_sink)
+		{
+			auto st_sink = std::make_shared<spdlog::sinks::null_sink_st>();
+			spdlog::logger sync_logger("sync", st_sink);
+			auto tp = std::make_shared<spdlog::details::thread_pool>(64, 1);
+			spdlog::async_logger async_logger("async", std::make_shared<test_sink>(), tp);
+
+			Assert::ExpectException<spdlog::spdlog_ex>([&] { async_logger.add_sink(st_sink); });
+			Assert::AreEqual(size_t(1), async_logger.sinks().size());
+
+			// released by remove_sink()
+			sync_logger.remove_sink(st_sink);
+			async_logger.add_sink(st_sink);
+			Assert::AreEqual(size_t(2), async_logger.sinks().size());
+		}
+	};
+}
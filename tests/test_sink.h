@@ -0,0 +1,105 @@
+#pragma once
+
+#include "spdlog/sinks/base_sink.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace spdlogTests
+{
+	// sink recording the payloads of the msgs it is given, for the tests.
+	// close_gate() makes the sink calls wait for open_gate() - e.g. to keep a worker
+	// thread busy while its queue fills up.
+	class test_sink : public spdlog::sinks::base_sink<std::mutex>
+	{
+	public:
+		std::vector<std::string> lines()
+		{
+			std::lock_guard<std::mutex> lock(data_mutex_);
+			return lines_;
+		}
+
+		size_t count()
+		{
+			std::lock_guard<std::mutex> lock(data_mutex_);
+			return lines_.size();
+		}
+
+		size_t flush_count()
+		{
+			std::lock_guard<std::mutex> lock(data_mutex_);
+			return flush_count_;
+		}
+
+		// number of msgs written when the sink was last flushed
+		size_t count_at_last_flush()
+		{
+			std::lock_guard<std::mutex> lock(data_mutex_);
+			return count_at_last_flush_;
+		}
+
+		void close_gate()
+		{
+			std::lock_guard<std::mutex> lock(gate_mutex_);
+			gate_open_ = false;
+		}
+
+		void open_gate()
+		{
+			{
+				std::lock_guard<std::mutex> lock(gate_mutex_);
+				gate_open_ = true;
+			}
+			gate_cv_.notify_all();
+		}
+
+		// wait until a sink call waits at the closed gate
+		void wait_at_gate()
+		{
+			std::unique_lock<std::mutex> lock(gate_mutex_);
+			gate_cv_.wait(lock, [this] { return waiting_ > 0; });
+		}
+
+	protected:
+		void sink_it_(const spdlog::details::log_msg &msg) override
+		{
+			pass_gate_();
+			std::lock_guard<std::mutex> lock(data_mutex_);
+			lines_.emplace_back(msg.payload.data(), msg.payload.size());
+		}
+
+		void flush_() override
+		{
+			pass_gate_();
+			std::lock_guard<std::mutex> lock(data_mutex_);
+			flush_count_++;
+			count_at_last_flush_ = lines_.size();
+		}
+
+	private:
+		void pass_gate_()
+		{
+			std::unique_lock<std::mutex> lock(gate_mutex_);
+			if (gate_open_)
+			{
+				return;
+			}
+			waiting_++;
+			gate_cv_.notify_all();
+			gate_cv_.wait(lock, [this] { return gate_open_; });
+			waiting_--;
+		}
+
+		std::mutex data_mutex_;
+		std::vector<std::string> lines_;
+		size_t flush_count_ = 0;
+		size_t count_at_last_flush_ = 0;
+
+		std::mutex gate_mutex_;
+		std::condition_variable gate_cv_;
+		bool gate_open_ = true;
+		size_t waiting_ = 0;
+	};
+}